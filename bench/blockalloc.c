@@ -0,0 +1,147 @@
+/**
+ * Host benchmark of the block allocator behind malloc. It runs on the
+ * build machine and links the allocator and the page manager directly:
+ *
+ *   gcc -O2 -fno-builtin -DNDEBUG -I include bench/blockalloc.c \
+ *       libs/mem-alloc/blockalloc.c libs/mem-alloc/pageman.c -o blockalloc-bench
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mem-alloc/pageman.h"
+#include "mem-alloc/blockalloc.h"
+
+enum {
+    PAGE_SIZE = 4096,
+    /* 256 MiB heap */
+    PAGES = 65536,
+    LIVE = 8192,
+    ROUNDS = 300000
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned seed;
+
+static unsigned next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/* Sizes seen in the boot manager: mostly small strings and nodes, some
+ * buffers up to a page, and a few bigger tables */
+static size_t mixedSize(void) {
+    unsigned r = next() % 100;
+    if (r < 70) {
+        return 8 + next() % 248;
+    } else if (r < 95) {
+        return 256 + next() % 3800;
+    } else {
+        return 4096 + next() % 61440;
+    }
+}
+
+/* Only sizes served from the size classes, spread evenly */
+static size_t smallSize(void) {
+    return 8 + next() % 4000;
+}
+
+/* Sizes above the size classes, carved from spans unless they fill whole
+ * pages well enough */
+static size_t midSize(void) {
+    return 4096 + next() % 61440;
+}
+
+/* Bytes taken from the page manager at the peak of the last trace */
+static size_t peak;
+
+/* Replay a random trace of mallocs and frees against a live set of count
+ * blocks, so the size classes are well spread. Returns ns per operation. */
+static double trace(char *mem, size_t (*traceSize)(void), int count) {
+    static void *live[LIVE];
+    pageman_t *man = pageman_create(mem, PAGES, mem, PAGES);
+    allocator_t *al = allocator_create(man);
+    memset(live, 0, sizeof(live));
+    seed = 1;
+
+    /* Warm up to a steady state before timing */
+    for (int i = 0; i < count; i++) {
+        live[i] = allocator_malloc(al, traceSize());
+    }
+    double start = now();
+    for (int i = 0; i < ROUNDS; i++) {
+        unsigned slot = next() % count;
+        allocator_free(al, live[slot]);
+        live[slot] = allocator_malloc(al, traceSize());
+    }
+    double time = now() - start;
+    pageman_stats_t stats;
+    pageman_getStats(man, &stats);
+    peak = stats.peak;
+    return time * 1e9 / (ROUNDS * 2);
+}
+
+static double mixed(char *mem) {
+    return trace(mem, mixedSize, LIVE);
+}
+
+static double small(char *mem) {
+    return trace(mem, smallSize, LIVE);
+}
+
+/* Fewer of them, so they fit in the heap */
+static double mid(char *mem) {
+    return trace(mem, midSize, LIVE / 8);
+}
+
+/* Allocate LIVE small blocks in a row and free them, like building a parse
+ * tree. Each block is carved from what is left of the current page, which
+ * sits in one of the largest size classes. Returns ns per operation. */
+static double burst(char *mem) {
+    static void *live[LIVE];
+    pageman_t *man = pageman_create(mem, PAGES, mem, PAGES);
+    allocator_t *al = allocator_create(man);
+    double start = now();
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < LIVE; i++) {
+            live[i] = allocator_malloc(al, 24);
+        }
+        for (int i = 0; i < LIVE; i++) {
+            allocator_free(al, live[i]);
+        }
+    }
+    double time = now() - start;
+    return time * 1e9 / (20 * LIVE * 2);
+}
+
+static void run(const char *name, double (*fn)(char *), char *mem) {
+    double best = 1e9;
+    for (int i = 0; i < 15; i++) {
+        double cost = fn(mem);
+        if (cost < best) {
+            best = cost;
+        }
+    }
+    printf("%-20s %8.1f ns/op\n", name, best);
+}
+
+int main(void) {
+    char *mem = aligned_alloc(PAGE_SIZE, (size_t)PAGES * PAGE_SIZE);
+    /* Fault the heap in first, so page faults are not timed */
+    memset(mem, 0, (size_t)PAGES * PAGE_SIZE);
+    run("mixed-size trace", mixed, mem);
+    run("small-size trace", small, mem);
+    run("mid-size trace", mid, mem);
+    printf("%-20s %8zu KiB\n", "mid-size peak", peak / 1024);
+    run("small burst", burst, mem);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * Host benchmark of the printf engine. It runs on the build machine and
+ * links libs/lib-format/format.c, whose sprintf takes the place of the C
+ * library one. Results are printed with fprintf, which stays the C
+ * library's:
+ *
+ *   gcc -O2 -fno-builtin -DNDEBUG -I include bench/format.c \
+ *       libs/lib-format/format.c -o format-bench
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+enum {
+    VALUES = 1 << 16
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned seed;
+
+static unsigned next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed;
+}
+
+/* Values of every length, from 1 to 10 digits */
+static uint32_t values[VALUES];
+static char buf[128];
+
+/* The console sink of format.c writes here, it is not timed */
+void putchars(const char *str, size_t len) {
+    fwrite(str, 1, len, stdout);
+}
+
+static void tenDigits(int i) {
+    sprintf(buf, "%u", 4000000000U + values[i] % 100000000);
+}
+
+static void eightHex(int i) {
+    sprintf(buf, "%x", 0x80000000U | values[i]);
+}
+
+static void randomDecimal(int i) {
+    sprintf(buf, "%u", values[i]);
+}
+
+static void paddedHex(int i) {
+    sprintf(buf, "%08X", values[i]);
+}
+
+static void decimal64(int i) {
+    sprintf(buf, "%llu", (unsigned long long)values[i] * values[i] * 3);
+}
+
+static void hex64(int i) {
+    sprintf(buf, "%llX", (unsigned long long)values[i] * values[i] * 3);
+}
+
+/* A line like the ones the boot manager logs */
+static void logLine(int i) {
+    sprintf(buf, "[INFO] [MEM]: %d KiB %x %s\n", values[i], values[i], "free");
+}
+
+/* Returns ns per call */
+static double measure(void (*fn)(int)) {
+    double start = now();
+    for (int i = 0; i < VALUES; i++) {
+        fn(i);
+    }
+    return (now() - start) * 1e9 / VALUES;
+}
+
+static void run(const char *name, void (*fn)(int)) {
+    double best = 1e9;
+    for (int i = 0; i < 15; i++) {
+        double cost = measure(fn);
+        if (cost < best) {
+            best = cost;
+        }
+    }
+    fprintf(stdout, "%-20s %8.1f ns/op\n", name, best);
+}
+
+int main(void) {
+    seed = 1;
+    for (int i = 0; i < VALUES; i++) {
+        uint32_t value = next();
+        values[i] = value >> (value % 32);
+    }
+    run("%u, 10 digits", tenDigits);
+    run("%x, 8 digits", eightHex);
+    run("%u, random", randomDecimal);
+    run("%08X, random", paddedHex);
+    run("%llu, 64-bit", decimal64);
+    run("%llX, 64-bit", hex64);
+    run("log line", logLine);
+    return 0;
+}
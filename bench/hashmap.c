@@ -0,0 +1,102 @@
+/**
+ * Host benchmark of walking a hashmap. It runs on the build machine and
+ * links libs/data-struct/hashmap.c, with the tagged allocation functions
+ * it calls forwarded to the C library:
+ *
+ *   gcc -O2 -fno-builtin -DNDEBUG -I include bench/hashmap.c \
+ *       libs/data-struct/hashmap.c -o hashmap-bench
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "data-struct/hashmap.h"
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void *malloc_tagged(enum malloc_tag tag, size_t size) {
+    return malloc(size);
+}
+
+void *calloc_tagged(enum malloc_tag tag, size_t nmemb, size_t size) {
+    return calloc(nmemb, size);
+}
+
+void free_tagged(enum malloc_tag tag, void *addr) {
+    free(addr);
+}
+
+/* Keys are the numbers themselves */
+static int intHash(void *key) {
+    return (int)(uintptr_t)key;
+}
+
+static int intCompare(void *a, void *b) {
+    return a != b;
+}
+
+static uintptr_t sum;
+
+static void add(void *ctx, void *key, void *value) {
+    sum += (uintptr_t)value;
+}
+
+static void walkForEach(hashmap_t *hm) {
+    hashmap_forEach(hm, add, NULL);
+}
+
+static void walkIter(hashmap_t *hm) {
+    hashmap_iter_t it;
+    hashmap_iterInit(hm, &it);
+    while (hashmap_iterNext(&it)) {
+        sum += (uintptr_t)it.value;
+    }
+}
+
+/* Returns ns per entry */
+static double measure(void (*fn)(hashmap_t *), hashmap_t *hm, int count) {
+    /* About the same number of entries visited for every size */
+    int rounds = (1 << 24) / count;
+    double start = now();
+    for (int i = 0; i < rounds; i++) {
+        fn(hm);
+    }
+    return (now() - start) * 1e9 / rounds / count;
+}
+
+static void run(const char *name, void (*fn)(hashmap_t *), hashmap_t *hm, int count) {
+    double best = 1e9;
+    for (int i = 0; i < 15; i++) {
+        double cost = measure(fn, hm, count);
+        if (cost < best) {
+            best = cost;
+        }
+    }
+    printf("%-10s %8d %8.2f ns/entry\n", name, count, best);
+}
+
+int main(void) {
+    /* From a table in the L1 cache to one far bigger than the last level */
+    static const int counts[] = {1 << 10, 1 << 14, 1 << 18, 1 << 21};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        hashmap_t *hm = hashmap_new(intHash, intCompare, 0);
+        hashmap_reserve(hm, counts[i]);
+        /* Multiplying by an odd number scatters the keys without repeats */
+        for (int j = 1; j <= counts[i]; j++) {
+            hashmap_put(hm, (void *)(uintptr_t)(j * 2654435761U), (void *)(uintptr_t)j);
+        }
+        run("forEach", walkForEach, hm, counts[i]);
+        run("iterNext", walkIter, hm, counts[i]);
+        hashmap_dispose(hm);
+    }
+    /* Keep the sums from being optimized away */
+    return sum == 42;
+}
@@ -0,0 +1,130 @@
+/**
+ * Host benchmark of the buddy page manager. It runs on the build machine,
+ * not in the boot manager, and links libs/mem-alloc/pageman.c directly:
+ *
+ *   gcc -O2 -fno-builtin -DNDEBUG -I include bench/pageman.c \
+ *       libs/mem-alloc/pageman.c -o pageman-bench
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "mem-alloc/pageman.h"
+
+enum {
+    PAGE_SIZE = 4096,
+    /* 256 MiB heap */
+    PAGES = 65536,
+    LIVE = 4096,
+    ROUNDS = 300000,
+    /* The 1 GiB guest the makescript boots, usable from 32 MiB on */
+    BOOT_PAGES = 262144,
+    BOOT_START = 8192
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static unsigned seed = 1;
+
+static unsigned next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/* Mostly small orders with the occasional large one, on a heap kept
+ * fragmented by a live set of LIVE blocks. Returns operations per second */
+static double churn(char *mem) {
+    static void *live[LIVE];
+    static size_t order[LIVE];
+    pageman_t *man = pageman_create(mem, PAGES, mem, PAGES);
+    memset(live, 0, sizeof(live));
+    seed = 1;
+
+    size_t ops = 0;
+    double start = now();
+    for (int i = 0; i < ROUNDS; i++) {
+        unsigned slot = next() % LIVE;
+        if (live[slot]) {
+            pageman_free(man, live[slot], order[slot]);
+            live[slot] = NULL;
+        } else {
+            unsigned r = next() % 100;
+            order[slot] = r < 60 ? 0 : r < 85 ? 1 : r < 95 ? 2 : 3 + next() % 5;
+            live[slot] = pageman_alloc(man, order[slot]);
+        }
+        ops++;
+    }
+    double time = now() - start;
+
+    for (int i = 0; i < LIVE; i++) {
+        if (live[i]) {
+            pageman_free(man, live[i], order[i]);
+        }
+    }
+    return ops / time;
+}
+
+/* Allocate and free a single page on an otherwise empty half of the heap,
+ * so every allocation splits a large block and every free merges it back */
+static double deep(char *mem) {
+    pageman_t *man = pageman_create(mem, PAGES, mem, PAGES);
+    /* The manager sits in the first half, which ends up in small blocks,
+     * while the second half is a single block. Use up the first half. */
+    char *half = mem + (size_t)PAGES / 2 * PAGE_SIZE;
+    void *page;
+    while ((char *)(page = pageman_alloc(man, 0)) < half);
+    pageman_free(man, page, 0);
+    double start = now();
+    for (int i = 0; i < ROUNDS; i++) {
+        pageman_free(man, pageman_alloc(man, 0), 0);
+    }
+    double time = now() - start;
+    return ROUNDS * 2 / time;
+}
+
+/* Create a manager over the usable memory of a 1 GiB guest, which is what
+ * the boot manager does before its first allocation. Only the pages
+ * actually written get backed by the host. Returns creations per second. */
+static double create(char *mem) {
+    static char *boot;
+    if (!boot) {
+        boot = mmap(NULL, (size_t)BOOT_PAGES * PAGE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    double start = now();
+    for (int i = 0; i < 1000; i++) {
+        pageman_create(boot, BOOT_PAGES, boot + (size_t)BOOT_START * PAGE_SIZE, BOOT_PAGES - BOOT_START);
+    }
+    double time = now() - start;
+    return 1000 / time;
+}
+
+static void run(const char *name, double (*fn)(char *), char *mem) {
+    double best = 0;
+    for (int i = 0; i < 25; i++) {
+        double rate = fn(mem);
+        if (rate > best) {
+            best = rate;
+        }
+    }
+    printf("%-20s %8.1f ns/op\n", name, 1e9 / best);
+}
+
+int main(void) {
+    char *mem = aligned_alloc(PAGE_SIZE, (size_t)PAGES * PAGE_SIZE);
+    /* Fault the heap in first, so page faults are not timed */
+    memset(mem, 0, (size_t)PAGES * PAGE_SIZE);
+    run("alloc/free churn", churn, mem);
+    run("split/merge", deep, mem);
+    run("create 1 GiB", create, mem);
+    return 0;
+}
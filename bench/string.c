@@ -0,0 +1,95 @@
+/**
+ * Host benchmark of the scalar memcpy, memset and memmove. It runs on the
+ * build machine and links libs/clib-independent/string.c, whose functions
+ * take the place of the C library ones. string_initSimd is never called,
+ * so the SIMD kernels are linked but not used:
+ *
+ *   gcc -O2 -fno-builtin -I include -c libs/clib-independent/string-sse2.c -msse2
+ *   gcc -O2 -fno-builtin -I include -c libs/clib-independent/string-avx2.c -mavx2
+ *   gcc -O2 -fno-builtin -DNDEBUG -I include bench/string.c \
+ *       libs/clib-independent/string.c string-sse2.o string-avx2.o -o string-bench
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+    /* Bytes moved per measurement, so every size takes about as long */
+    VOLUME = 16 << 20,
+    BUF_SIZE = 4 << 20
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static char *src, *dst;
+
+/* The destination is off by one, so the alignment code is always run */
+static void copy(size_t size) {
+    memcpy(dst + 1, src, size);
+}
+
+static void fill(size_t size) {
+    memset(dst + 1, 0x5a, size);
+}
+
+/* Overlapping, with the destination above the source */
+static void move(size_t size) {
+    memmove(dst + 3, dst, size);
+}
+
+/* Returns ns per call */
+static double measure(void (*fn)(size_t), size_t size) {
+    size_t calls = VOLUME / size;
+    if (calls > 1000000) {
+        calls = 1000000;
+    }
+    double start = now();
+    for (size_t i = 0; i < calls; i++) {
+        fn(size);
+        /* Keep the calls from being merged or dropped */
+        __asm__ volatile("" ::: "memory");
+    }
+    return (now() - start) * 1e9 / calls;
+}
+
+static void run(const char *name, void (*fn)(size_t), size_t size) {
+    double best = 1e9;
+    for (int i = 0; i < 15; i++) {
+        double cost = measure(fn, size);
+        if (cost < best) {
+            best = cost;
+        }
+    }
+    printf("%-8s %8zu %10.1f ns/op %8.0f MB/s\n", name, size, best, size / best * 1e3);
+}
+
+int main(void) {
+    /* Sizes around WORD_THRESHOLD and REP_THRESHOLD, then bulk sizes up
+     * to ones which no longer fit in the cache */
+    static const size_t sizes[] = {
+        4, 8, 15, 16, 24, 32, 64, 128, 255, 256, 512, 4096, 65536,
+        1 << 20, 2 << 20, 4 << 20
+    };
+    src = aligned_alloc(64, BUF_SIZE + 64);
+    dst = aligned_alloc(64, BUF_SIZE + 64);
+    memset(src, 1, BUF_SIZE + 64);
+    memset(dst, 2, BUF_SIZE + 64);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run("memcpy", copy, sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run("memset", fill, sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run("memmove", move, sizes[i]);
+    }
+    return 0;
+}
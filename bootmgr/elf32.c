@@ -2,29 +2,24 @@
 #include "c/stdio.h"
 #include "c/string.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/assert.h"
 
-#include "data-struct/hashmap.h"
+#include "data-struct/typedmap.h"
 
 #include "elf/elf32.h"
 
-hashmap_t *symbolMap = NULL;
+DEFINE_HASHMAP(symmap, const char *, void *, typedmap_stringHash, typedmap_stringEquals)
 
-#define HASH_POOL_SIZE 31
+static symmap_t symbolMap = { .tag = MALLOC_TAG_ELF };
 
 void add_symbol(char *name, void *addr) {
-    if (symbolMap == NULL) {
-        symbolMap = hashmap_new_string(HASH_POOL_SIZE);
-    }
-    hashmap_put(symbolMap, name, addr);
+    symmap_put(&symbolMap, name, addr);
 }
 
 static uint32_t resolve_external_symbol(char *name) {
-    if (symbolMap == NULL) {
-        return 0;
-    }
-    void *ent = hashmap_get(symbolMap, name);
-    return (uint32_t)ent;
+    void **ent = symmap_get(&symbolMap, name);
+    return ent ? (uint32_t)*ent : 0;
 }
 
 static uint32_t resolve_symbol(Elf32_Ehdr *header, char *strtab, Elf32_Sym *symbol) {
@@ -57,8 +52,7 @@ static uint32_t resolve_symbol(Elf32_Ehdr *header, char *strtab, Elf32_Sym *symb
             return 0;
         }
         case SHN_COMMON: {
-            void *ret = malloc(symbol->st_size);
-            memset(ret, 0, symbol->st_size);
+            void *ret = calloc_tagged(MALLOC_TAG_ELF, 1, symbol->st_size);
             symbol->st_shndx = SHN_ABS;
             symbol->st_value = (uint32_t)ret;
             return (uint32_t)ret;
@@ -67,8 +61,7 @@ static uint32_t resolve_symbol(Elf32_Ehdr *header, char *strtab, Elf32_Sym *symb
             Elf32_Shdr *section = ELF32_SH_GET(header, symbol->st_shndx);
             uint32_t ret;
             if (section->sh_type == SHT_NOBITS) {
-                void *ptr = malloc(section->sh_size);
-                memset(ptr, 0, section->sh_size);
+                void *ptr = calloc_tagged(MALLOC_TAG_ELF, 1, section->sh_size);
                 ret = (uint32_t)ptr;
             } else {
                 ret = (uint32_t)
@@ -14,6 +14,7 @@
 #include "mem-alloc/pageman.h"
 #include "c-stdlib/malloc.h"
 #include "asm/asm.h"
+#include "asm/cpu.h"
 
 #include "data-struct/hashmap.h"
 
@@ -43,6 +44,46 @@ void add_symbol(char *, void *);
 void link_elf32(void *);
 int exec_elf32(void *);
 
+/* Enable the SSE and AVX register state, then let the string functions
+ * switch to SIMD kernels. The boot manager runs on one CPU with interrupts
+ * off, so the registers are never saved. Any other CPU must run this too
+ * before calling the string functions, or the kernels fault with #UD. */
+static void enableSimd(void) {
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    if ((regs[3] & CPUID_EDX_FXSR) && (regs[3] & CPUID_EDX_SSE)) {
+        writeCR0((readCR0() & ~(CR0_EM | CR0_TS)) | CR0_MP);
+        writeCR4(readCR4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        __asm__ __volatile__("fninit");
+    }
+    if ((regs[2] & CPUID_ECX_XSAVE) && (regs[2] & CPUID_ECX_AVX)) {
+        writeCR4(readCR4() | CR4_OSXSAVE);
+        writeXCR0(readXCR0() | XCR0_X87 | XCR0_SSE | XCR0_AVX);
+    }
+    string_initSimd();
+}
+
+/* Print the statistics of the heap and the page manager */
+static void printMemStats(pageman_t *man) {
+    allocator_stats_t heap;
+    pageman_stats_t page;
+    malloc_getStats(&heap);
+    pageman_getStats(man, &page);
+    printf("[INFO] [MEM]: Heap: %d KiB in use, %d KiB peak\n", heap.used / 1024, heap.peak / 1024);
+    printf("[INFO] [MEM]: Heap: %d exact, %d split, %d fresh, %d large, %d in place\n",
+           heap.exact, heap.split, heap.fresh, heap.large, heap.inPlace);
+    printf("[INFO] [MEM]: Pages: %d KiB in use, %d KiB peak, %d KiB known zero\n",
+           page.used / 1024, page.peak / 1024, page.zero / 1024);
+    printf("[INFO] [MEM]: Free blocks:");
+    for (size_t level = 0; level < PAGEMAN_TOTAL_LEVEL; level++) {
+        if (page.freeBlocks[level]) {
+            printf(" %d:%d", level, page.freeBlocks[level]);
+        }
+    }
+    putchar('\n');
+    malloc_dumpTags();
+}
+
 /**
  * C code entrance.
  * Notice that void main(void) is not violence of C standard,
@@ -52,55 +93,44 @@ void main(void) {
     /* Clear the screen */
     putchar('\f');
 
-    uint32_t maxAddr = 0;
-    /* We assume the memory maps are arranged in ascending order */
-    for (int i = memMapEntryLen - 1; i >= 0; i--) {
-        memmap_entry_t *entry = &memMapPtr[i];
-        if (entry->type == 1) {
-            uint64_t limit = entry->base + entry->limit;
-            if (limit > 0xFFFFFFFF) {
-                maxAddr = 0xFFFFFFFF;
-            } else {
-                maxAddr = (uint32_t)limit;
-            }
-            break;
-        }
-    }
+    enableSimd();
 
     pageman_t *man = NULL;
+    uint64_t highMem = 0;
 
-    /* In the following algorithm, we will ignore memory over 0xFFFFFFFF,
-     * since currently we are in 32 bit mode without paging, therefore we
-     * have no way to make use of these memory */
+    /* Every usable memory region becomes a zone of the page manager.
+     * Memory over 0xFFFFFFFF is only counted, since currently we are in
+     * 32 bit mode without paging, therefore we have no way to make use
+     * of these memory */
     for (int i = 0; i < memMapEntryLen; i++) {
         memmap_entry_t *entry = &memMapPtr[i];
-        if (entry->type == 1) {
-            if (entry->base < 0x100000) {
-                /* We assume no memory block will cross 0x100000,
-                 * because normally 0x9FC00-0x100000 is BIOS reserved
-                 * memory area. */
-                continue;
-            } else if (entry->base <= 0xFFFFFFFF) {
-                /* We assume no memory block will cross 0xFFFFFFFF,
-                 * because normally APIC memory area will locate
-                 * between 0xFFFC000 - 0xFFFFFFFF. */
-                size_t base = entry->base;
-                size_t limit = entry->limit;
-                if (base < AVAIL_MEM_START) {
-                    if (base + limit <= AVAIL_MEM_START) {
-                        continue;
-                    } else {
-                        limit -= AVAIL_MEM_START - base;
-                        base = AVAIL_MEM_START;
-                    }
-                }
-                if (man) {
-                    pageman_freeBlock(man, (void *)(size_t)base, limit);
-                } else {
-                    man = pageman_create(NULL, maxAddr / PAGE_SIZE, (void *)(size_t)base, limit / PAGE_SIZE);
-                    break;
-                }
-            }
+        if (entry->type != 1) {
+            continue;
+        }
+        uint64_t base = entry->base;
+        uint64_t limit = entry->base + entry->limit;
+        if (limit > 0x100000000ULL) {
+            highMem += limit - (base > 0x100000000ULL ? base : 0x100000000ULL);
+            limit = 0x100000000ULL;
+        }
+        /* Memory below AVAIL_MEM_START is used by the boot manager itself */
+        if (base < AVAIL_MEM_START) {
+            base = AVAIL_MEM_START;
+        }
+        base = (base + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        if (base >= limit) {
+            continue;
+        }
+        size_t pages = (size_t)(limit - base) / PAGE_SIZE;
+        pageman_t *zone = pageman_create((void *)(size_t)base, pages, (void *)(size_t)base, pages);
+        /* The region is too small to even hold its own bitmaps */
+        if (zone == NULL) {
+            continue;
+        }
+        if (man) {
+            pageman_addZone(man, zone);
+        } else {
+            man = zone;
         }
     }
 
@@ -115,13 +145,14 @@ void main(void) {
     /* Print all memory entries */
     for (int i = 0; i < memMapEntryLen; i++) {
         memmap_entry_t *entry = &memMapPtr[i];
-        if (entry->base <= 0xFFFFFFFF) {
-            if (entry->type > 5 || entry->type == 0) {
-                entry->type = 2;
-            }
-            printf("[INFO] [MEM]: %08X %08X %s\n", (size_t)entry->base, (size_t)entry->limit,
-                   typeName[entry->type - 1]);
+        if (entry->type > 5 || entry->type == 0) {
+            entry->type = 2;
         }
+        printf("[INFO] [MEM]: %09llX %09llX %s\n", entry->base, entry->limit,
+               typeName[entry->type - 1]);
+    }
+    if (highMem) {
+        printf("[INFO] [MEM]: %llu MiB above 4 GiB is not addressable\n", highMem >> 20);
     }
 
     /* Create VFS and mount necessary file systems */
@@ -138,7 +169,7 @@ void main(void) {
            spare / 1024 / 1024 / 1024,
            spare / 1024 / 1024 % 1024,
            spare / 1024 % 1024);
-
+    printMemStats(man);
 
     /* Load the sakiload */
     fs_node_t *exec = vfs_lookup("/media/cdrom/saki/bootmgr/js.ske");
@@ -156,10 +187,26 @@ void main(void) {
     EXPORT(memcmp);
     EXPORT(memset);
     EXPORT(memcpy);
+    EXPORT(memchr);
 
     EXPORT(malloc);
     EXPORT(free);
     EXPORT(realloc);
+    EXPORT(malloc_tagged);
+    EXPORT(calloc_tagged);
+    EXPORT(realloc_tagged);
+    EXPORT(free_tagged);
+    EXPORT(malloc_dumpTags);
+
+    EXPORT(objcache_new);
+    EXPORT(objcache_alloc);
+    EXPORT(objcache_free);
+
+    EXPORT(arena_new);
+    EXPORT(arena_alloc);
+    EXPORT(arena_mark);
+    EXPORT(arena_rewind);
+    EXPORT(arena_destroy);
 
     EXPORT(isnan);
     EXPORT(isinf);
@@ -182,11 +229,16 @@ void main(void) {
 
     /* Hashmap */
     EXPORT(hashmap_new);
+    EXPORT(hashmap_newTagged);
+    EXPORT(hashmap_reserve);
     EXPORT(hashmap_put);
     EXPORT(hashmap_get);
     EXPORT(hashmap_remove);
     EXPORT(hashmap_iterator);
     EXPORT(hashmap_next);
+    EXPORT(hashmap_iterInit);
+    EXPORT(hashmap_iterNext);
+    EXPORT(hashmap_forEach);
 
     /* Symbol Table */
     EXPORT(add_symbol);
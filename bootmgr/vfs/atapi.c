@@ -3,6 +3,7 @@
 #include "c/assert.h"
 #include "c/string.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "util/alignment.h"
 #include "util/endian.h"
 #include "asm/asm.h"
@@ -77,6 +78,10 @@ static void ATA_select(atapi_data_t *data) {
 
 static int ATA_waitDevice(atapi_data_t *data) {
     uint8_t status;
+    /* The command has just been issued, so the device is about to be busy.
+     * Clear one page in the meantime, but keep the polling loop tight so
+     * the device is not left waiting once it is done. */
+    malloc_idle();
     while (true) {
         status = readPort8(data->bus + ATA_STATUS);
         if ((status & (1 << 7)) == 0) {
@@ -191,7 +196,7 @@ static uint64_t read(fs_node_t *node, uint64_t _offset, uint64_t _size, void *bu
 }
 
 fs_node_t *ATAPI_init(void) {
-    buf = malloc(2048);
+    buf = malloc_tagged(MALLOC_TAG_VFS, 2048);
     printf("[ATAPI BUFFER %p]", buf);
 
     if (ATAPI_identify(&device)) {
@@ -1,8 +1,10 @@
 
 #include "c/stdint.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/assert.h"
 #include "c/string.h"
+#include "data-struct/vector.h"
 #include "bootmgr/vfs.h"
 
 typedef struct {
@@ -67,8 +69,9 @@ typedef struct {
     dir_rec_t dirent;
 } cdfs_data_t;
 
+DEFINE_VECTOR(cdfs_nodes, fs_node_t *)
+
 #define BUFFER_SIZE 2048
-#define NODE_BUFFER_SIZE 128
 
 static uint64_t read(fs_node_t *node, uint64_t offset, uint64_t size, void *buffer);
 static fs_node_t *readdir(fs_node_t *node, uint32_t index);
@@ -83,7 +86,6 @@ static fs_op_t ops = {
 };
 
 static char *buffer = NULL;
-static fs_node_t **nodeBuffer = NULL;
 
 static uint64_t read(fs_node_t *node, uint64_t offset, uint64_t size, void *buffer) {
     assert(node->type != DIR);
@@ -102,7 +104,8 @@ static fs_node_t *readdir(fs_node_t *node, uint32_t index) {
     cdfs_data_t *data = node->dataPtr;
     if (data->cache == NULL) {
         assert(data->dirent.sizeL <= BUFFER_SIZE);
-        size_t id = 0;
+        cdfs_nodes_t nodes;
+        cdfs_nodes_init(&nodes, MALLOC_TAG_VFS);
 
         vfs_read(data->cdrom, data->dirent.lbaL * 2048, 2048, buffer);
         for (dir_rec_t *rec = (dir_rec_t *)buffer; rec->length != 0;
@@ -115,12 +118,12 @@ static fs_node_t *readdir(fs_node_t *node, uint32_t index) {
                 continue;
             }
 
-            cdfs_data_t *newdata = malloc(sizeof(cdfs_data_t));
+            cdfs_data_t *newdata = malloc_tagged(MALLOC_TAG_VFS, sizeof(cdfs_data_t));
             memcpy(&newdata->dirent, rec, sizeof(dir_rec_t));
             newdata->cdrom = data->cdrom;
             newdata->cache = NULL;
 
-            fs_node_t *node = malloc(sizeof(fs_node_t));
+            fs_node_t *node = malloc_tagged(MALLOC_TAG_VFS, sizeof(fs_node_t));
             node->name = NULL;
             node->op = &ops;
             node->pointer = NULL;
@@ -138,23 +141,22 @@ static fs_node_t *readdir(fs_node_t *node, uint32_t index) {
             while (lenRest > 3) {
                 lenRest -= sue->length;
                 if (sue->id[0] == 'N' && sue->id[1] == 'M') {
-                    node->name = strndup((void *)sue + 5, sue->length - 5);
+                    node->name = strndup_tagged(MALLOC_TAG_VFS, (void *)sue + 5, sue->length - 5);
                 }
                 sue = (sys_use_entry_t *)((size_t)sue + sue->length);
             }
 
             if (node->name == NULL) {
-                node->name = strndup(rec->fileName, rec->nameLen);
+                node->name = strndup_tagged(MALLOC_TAG_VFS, rec->fileName, rec->nameLen);
             }
 
-            nodeBuffer[id++] = node;
+            cdfs_nodes_push(&nodes, node);
         }
-        nodeBuffer[id++] = NULL;
-
-        assert(id <= NODE_BUFFER_SIZE);
+        cdfs_nodes_push(&nodes, NULL);
 
-        data->cache = malloc(id * sizeof(fs_node_t *));
-        memcpy(data->cache, nodeBuffer, id * sizeof(fs_node_t *));
+        /* The list is kept as the cache, so give back the spare room */
+        cdfs_nodes_shrink(&nodes);
+        data->cache = nodes.data;
 
         //free(buffer);
     }
@@ -163,16 +165,15 @@ static fs_node_t *readdir(fs_node_t *node, uint32_t index) {
 
 fs_node_t *CDFS_create_fs(fs_node_t *cdrom) {
     if (buffer == NULL) {
-        buffer = malloc(BUFFER_SIZE);
-        nodeBuffer = malloc(NODE_BUFFER_SIZE * sizeof(fs_node_t *));
+        buffer = malloc_tagged(MALLOC_TAG_VFS, BUFFER_SIZE);
     }
 
-    cdfs_data_t *data = malloc(sizeof(cdfs_data_t));
+    cdfs_data_t *data = malloc_tagged(MALLOC_TAG_VFS, sizeof(cdfs_data_t));
     vfs_read(cdrom, 0x8000 + offsetof(prim_vol_desc_t, rootDir), sizeof(dir_rec_t), &data->dirent);
     data->cdrom = cdrom;
     data->cache = NULL;
 
-    fs_node_t *node = malloc(sizeof(fs_node_t));
+    fs_node_t *node = malloc_tagged(MALLOC_TAG_VFS, sizeof(fs_node_t));
     node->name = "cdfs";
     node->op = &ops;
     node->pointer = NULL;
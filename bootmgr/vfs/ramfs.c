@@ -5,10 +5,11 @@
  */
 
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/string.h"
 #include "c/assert.h"
 
-#include "util/alignment.h"
+#include "data-struct/vector.h"
 
 #include "bootmgr/vfs.h"
 
@@ -25,42 +26,36 @@ static fs_op_t ramfs_op = {
     .mkdir = ramfs_mkdir
 };
 
+DEFINE_VECTOR(ramfs_nodes, fs_node_t *)
+
+/* Files hold no data, as there is no read or write yet, so only
+ * directories have this */
 typedef struct struct_ramfs_data_t {
-    union {
-        fs_node_t **dir;
-        char *data;
-    };
-    uint64_t allocSize;
+    ramfs_nodes_t dir;
 } ramfs_data_t;
 
-static void ensureSize(fs_node_t *node, uint64_t size) {
-    ramfs_data_t *data = node->dataPtr;
-    if (size > data->allocSize) {
-        data->allocSize = alignTo(size, 512);
-        data->data = realloc(data->data, data->allocSize);
-    }
-}
-
 static fs_node_t *ramfs_readdir(fs_node_t *parent, uint32_t index) {
     assert(parent->type == DIR);
     ramfs_data_t *node = parent->dataPtr;
-    if (index * sizeof(size_t) >= parent->length) {
+    if (index >= node->dir.length) {
         return NULL;
     }
-    return node->dir[index];
+    return node->dir.data[index];
 }
 
 static fs_node_t *ramfs_createNode(fs_node_t *parent, char *name, uint8_t type) {
-    fs_node_t *ret = malloc(sizeof(fs_node_t));
-    ret->name = strdup(name);
+    fs_node_t *ret = malloc_tagged(MALLOC_TAG_VFS, sizeof(fs_node_t));
+    ret->name = strdup_tagged(MALLOC_TAG_VFS, name);
     ret->op = &ramfs_op;
     ret->pointer = NULL;
     ret->length = 0;
     ret->type = type;
 
-    ramfs_data_t *data = malloc(sizeof(ramfs_data_t));
-    data->allocSize = 128;
-    data->data = malloc(128);
+    ramfs_data_t *data = NULL;
+    if (type == DIR) {
+        data = malloc_tagged(MALLOC_TAG_VFS, sizeof(ramfs_data_t));
+        ramfs_nodes_init(&data->dir, MALLOC_TAG_VFS);
+    }
     ret->dataPtr = data;
 
     if (!parent) {
@@ -69,8 +64,13 @@ static fs_node_t *ramfs_createNode(fs_node_t *parent, char *name, uint8_t type)
 
     ramfs_data_t *node = parent->dataPtr;
     assert(parent->type == DIR);
-    ensureSize(parent, parent->length + sizeof(size_t));
-    node->dir[parent->length / sizeof(size_t)] = ret;
+    if (!ramfs_nodes_push(&node->dir, ret)) {
+        /* Out of memory, the parent is left as it was */
+        free_tagged(MALLOC_TAG_VFS, data);
+        free_tagged(MALLOC_TAG_VFS, ret->name);
+        free_tagged(MALLOC_TAG_VFS, ret);
+        return NULL;
+    }
     parent->length += sizeof(size_t);
     return ret;
 }
@@ -107,6 +107,10 @@ static fs_node_t *lookup(fs_node_t *node, char *path) {
             fs_node_t *cur = vfs_finddir(node, subPath);
             if (cur == NULL) {
                 cur = vfs_mkdir(node, subPath);
+                /* Out of memory */
+                if (cur == NULL) {
+                    return NULL;
+                }
             }
             return lookup(cur, pathEnd + 1);
         }
@@ -121,7 +125,7 @@ static fs_node_t *lookup(fs_node_t *node, char *path) {
 fs_node_t *vfs_lookup(char *path) {
     assert(path[0] == '/');
     fs_node_t *node = lookup(&root, path + 1);
-    while (node->pointer) {
+    while (node && node->pointer) {
         node = node->pointer;
     }
     return node;
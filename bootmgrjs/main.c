@@ -4,6 +4,7 @@
 #include "c/stdint.h"
 #include "c/stdlib.h"
 #include "c/assert.h"
+#include "c-stdlib/malloc.h"
 
 #include "unicode/type.h"
 #include "unicode/convert.h"
@@ -24,8 +25,10 @@ int main() {
 
     js_init();
 
-    lex_t *lex = lex_new(buffer);
-    grammar_t *gmr = grammar_new(lex);
+    /* The whole parse is released together */
+    arena_t *parse = arena_new(MALLOC_TAG_JS);
+    lex_t *lex = lex_new(buffer, parse);
+    grammar_t *gmr = grammar_new(lex, parse);
 
     //grammar_program(gmr);
     js_context_t context = {
@@ -39,6 +42,8 @@ int main() {
     js_string_t *str = js_toString(ret);
     unicode_putUtf16(str->value);
 
+    arena_destroy(parse);
+
     //js_toString(js_new_number(12345));
 
     return 0;
@@ -0,0 +1,81 @@
+/**
+ * Provide access to CPU identification and control registers
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef ASM_CPU_H
+#define ASM_CPU_H
+
+#include "c/stdint.h"
+#include "c/stddef.h"
+
+enum {
+    /* CPUID leaf 1, EDX */
+    CPUID_EDX_FXSR = 1 << 24,
+    CPUID_EDX_SSE = 1 << 25,
+    CPUID_EDX_SSE2 = 1 << 26,
+    /* CPUID leaf 1, ECX */
+    CPUID_ECX_XSAVE = 1 << 26,
+    CPUID_ECX_OSXSAVE = 1 << 27,
+    CPUID_ECX_AVX = 1 << 28,
+    /* CPUID leaf 7, EBX */
+    CPUID_EBX_AVX2 = 1 << 5,
+
+    CR0_MP = 1 << 1,
+    CR0_EM = 1 << 2,
+    CR0_TS = 1 << 3,
+
+    CR4_OSFXSR = 1 << 9,
+    CR4_OSXMMEXCPT = 1 << 10,
+    CR4_OSXSAVE = 1 << 18,
+
+    XCR0_X87 = 1 << 0,
+    XCR0_SSE = 1 << 1,
+    XCR0_AVX = 1 << 2
+};
+
+/**
+ * invoke cpuid assembly instruction
+ * @param leaf      value of EAX
+ * @param subleaf   value of ECX
+ * @param regs      receives EAX, EBX, ECX and EDX
+ */
+static inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    __asm__ __volatile__("cpuid"
+                         :"=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+                         :"a"(leaf), "c"(subleaf));
+}
+
+static inline uint32_t readCR0(void) {
+    size_t val;
+    __asm__ __volatile__("mov %%cr0, %0":"=r"(val));
+    return val;
+}
+
+static inline void writeCR0(uint32_t val) {
+    __asm__ __volatile__("mov %0, %%cr0"::"r"((size_t)val));
+}
+
+static inline uint32_t readCR4(void) {
+    size_t val;
+    __asm__ __volatile__("mov %%cr4, %0":"=r"(val));
+    return val;
+}
+
+static inline void writeCR4(uint32_t val) {
+    __asm__ __volatile__("mov %0, %%cr4"::"r"((size_t)val));
+}
+
+/* Only valid once CR4_OSXSAVE is set */
+static inline uint32_t readXCR0(void) {
+    uint32_t low, high;
+    __asm__ __volatile__("xgetbv":"=a"(low), "=d"(high):"c"(0));
+    return low;
+}
+
+static inline void writeXCR0(uint32_t val) {
+    __asm__ __volatile__("xsetbv"::"a"(val), "d"(0), "c"(0));
+}
+
+#endif
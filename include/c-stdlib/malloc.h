@@ -8,7 +8,30 @@
 #define C_STDLIB_MALLOC_H
 
 #include "mem-alloc/pageman.h"
+#include "mem-alloc/objcache.h"
+#include "mem-alloc/blockalloc.h"
+#include "mem-alloc/arena.h"
+
+/* Subsystems whose memory usage is accounted separately */
+enum malloc_tag {
+    MALLOC_TAG_DEFAULT,
+    MALLOC_TAG_VFS,
+    MALLOC_TAG_ELF,
+    MALLOC_TAG_JS,
+    MALLOC_TAG_COUNT
+};
 
 void init_allocator(pageman_t *man);
+objcache_t *objcache_new(enum malloc_tag tag, const char *name, size_t size, size_t align, void (*ctor)(void *));
+arena_t *arena_new(enum malloc_tag tag);
+void malloc_getStats(allocator_stats_t *stats);
+void *malloc_tagged(enum malloc_tag tag, size_t size);
+void *calloc_tagged(enum malloc_tag tag, size_t nmemb, size_t size);
+void *realloc_tagged(enum malloc_tag tag, void *addr, size_t size);
+void free_tagged(enum malloc_tag tag, void *addr);
+char *strdup_tagged(enum malloc_tag tag, const char *s);
+char *strndup_tagged(enum malloc_tag tag, const char *s, size_t n);
+void malloc_dumpTags(void);
+void malloc_idle(void);
 
 #endif
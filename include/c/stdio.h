@@ -8,10 +8,27 @@
 #define C_STDIO_H
 
 #include "c/stddef.h"
+#include "c/stdarg.h"
+
+/* Destination of formatted output. write is called with consecutive chunks
+ * of the output, which are not NUL-terminated. Embed it as the first member
+ * of a larger struct to carry state. */
+typedef struct printf_sink {
+    void (*write)(struct printf_sink *sink, const char *str, size_t len);
+} printf_sink_t;
 
 int putchar(int c);
+/* Write len characters, the same as putchar on each but faster */
+void putchars(const char *str, size_t len);
 int puts(const char *s);
 
+int vprintf(const char *fmt, va_list args);
 int printf(const char *fmt, ...);
+int vsprintf(char *buf, const char *fmt, va_list args);
+int sprintf(char *buf, const char *fmt, ...);
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+int snprintf(char *buf, size_t size, const char *fmt, ...);
+int vdprintf(printf_sink_t *sink, const char *fmt, va_list args);
+int dprintf(printf_sink_t *sink, const char *fmt, ...);
 
-#endif
\ No newline at end of file
+#endif
@@ -12,6 +12,7 @@
 void *memcpy(void *restrict s1, const void *restrict s2, size_t n);
 void *memmove(void *s1, const void *s2, size_t n);
 void *memset(void *s, int c, size_t n);
+void *memchr(const void *s, int c, size_t n);
 
 size_t strlen(const char *s);
 size_t strnlen(const char *s, size_t maxlen);
@@ -21,4 +22,6 @@ char *strndup(const char *s, size_t n);
 int strcmp(const char *s1, const char *s2);
 int memcmp(const void *s1, const void *s2, size_t n);
 
+void string_initSimd(void);
+
 #endif
\ No newline at end of file
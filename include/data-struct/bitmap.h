@@ -8,32 +8,207 @@
 #define DATA_STRUCT_BITMAP_H
 
 #include "c/stddef.h"
+#include "c/stdint.h"
 #include "c/stdbool.h"
 
+#include "util/log2.h"
+
 /**
  * bitmap
- * The bitmap is defined as unsigned char, so bitmap* can points to unsigned char*,
- * which is the first element actually in the bitmap.
+ * The bitmap is an array of 32-bit words, bit i is bit (i % 32) of word
+ * (i / 32). Scans and range operations work a word at a time, so the
+ * storage of a bitmap must be rounded up to whole words.
  */
-typedef unsigned char bitmap_t;
+typedef uint32_t bitmap_t;
+
+enum {
+    BITMAP_WORD_BITS = 32
+};
+
+/* Bytes needed for a bitmap of the given number of bits */
+static inline size_t bitmap_getSize(size_t bits) {
+    return (bits + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS * sizeof(bitmap_t);
+}
+
+static inline bool bitmap_get(bitmap_t *b, size_t index) {
+    return !!(b[index / BITMAP_WORD_BITS] & ((bitmap_t)1 << (index % BITMAP_WORD_BITS)));
+}
 
 static inline bool bitmap_switch(bitmap_t *b, size_t index) {
-    unsigned char mask = (unsigned char)(1 << (index & 7));
-    return !((b[index >> 3] ^= mask)&mask);
+    bitmap_t mask = (bitmap_t)1 << (index % BITMAP_WORD_BITS);
+    return !((b[index / BITMAP_WORD_BITS] ^= mask) & mask);
 }
 
 static inline bool bitmap_clear(bitmap_t *b, size_t index) {
-    unsigned char mask = (unsigned char)(1 << (index & 7));
-    bool ret = b[index >> 3] & mask;
-    b[index >> 3] &= ~mask;
-    return !!ret;
+    bitmap_t mask = (bitmap_t)1 << (index % BITMAP_WORD_BITS);
+    bool ret = b[index / BITMAP_WORD_BITS] & mask;
+    b[index / BITMAP_WORD_BITS] &= ~mask;
+    return ret;
 }
 
 static inline bool bitmap_set(bitmap_t *b, size_t index) {
-    unsigned char mask = (unsigned char)(1 << (index & 7));
-    bool ret = b[index >> 3] & mask;
-    b[index >> 3] |= mask;
-    return !!ret;
+    bitmap_t mask = (bitmap_t)1 << (index % BITMAP_WORD_BITS);
+    bool ret = b[index / BITMAP_WORD_BITS] & mask;
+    b[index / BITMAP_WORD_BITS] |= mask;
+    return ret;
+}
+
+/* Mask of the bits from the given one to the top of its word */
+static inline bitmap_t bitmap_headMask(size_t from) {
+    return ~(bitmap_t)0 << (from % BITMAP_WORD_BITS);
+}
+
+/* Mask of the bits from the bottom of its word to the given one inclusive */
+static inline bitmap_t bitmap_tailMask(size_t last) {
+    return ~(bitmap_t)0 >> (BITMAP_WORD_BITS - 1 - last % BITMAP_WORD_BITS);
+}
+
+/**
+ * bitmap_setRange
+ * Set count bits starting from the given one.
+ *
+ * @param b         The bitmap
+ * @param from      Index of the first bit
+ * @param count     Number of bits
+ */
+static inline void bitmap_setRange(bitmap_t *b, size_t from, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    size_t word = from / BITMAP_WORD_BITS;
+    size_t last = (from + count - 1) / BITMAP_WORD_BITS;
+    bitmap_t head = bitmap_headMask(from);
+    bitmap_t tail = bitmap_tailMask(from + count - 1);
+    if (word == last) {
+        b[word] |= head & tail;
+        return;
+    }
+    b[word++] |= head;
+    for (; word < last; word++) {
+        b[word] = ~(bitmap_t)0;
+    }
+    b[last] |= tail;
+}
+
+/**
+ * bitmap_clearRange
+ * Clear count bits starting from the given one.
+ *
+ * @param b         The bitmap
+ * @param from      Index of the first bit
+ * @param count     Number of bits
+ */
+static inline void bitmap_clearRange(bitmap_t *b, size_t from, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    size_t word = from / BITMAP_WORD_BITS;
+    size_t last = (from + count - 1) / BITMAP_WORD_BITS;
+    bitmap_t head = bitmap_headMask(from);
+    bitmap_t tail = bitmap_tailMask(from + count - 1);
+    if (word == last) {
+        b[word] &= ~(head & tail);
+        return;
+    }
+    b[word++] &= ~head;
+    for (; word < last; word++) {
+        b[word] = 0;
+    }
+    b[last] &= ~tail;
+}
+
+/* Scan for the first word with a bit set after flipping by invert */
+static inline size_t bitmap_scan(bitmap_t *b, size_t from, size_t size, bitmap_t invert) {
+    if (from >= size) {
+        return size;
+    }
+    size_t word = from / BITMAP_WORD_BITS;
+    bitmap_t bits = (b[word] ^ invert) & bitmap_headMask(from);
+    while (bits == 0) {
+        if (++word * BITMAP_WORD_BITS >= size) {
+            return size;
+        }
+        bits = b[word] ^ invert;
+    }
+    size_t index = word * BITMAP_WORD_BITS + lowestBit(bits);
+    return index < size ? index : size;
+}
+
+/**
+ * bitmap_findFirstSet
+ * Find the first set bit at or after the given one.
+ *
+ * @param b         The bitmap
+ * @param from      Index to start from
+ * @param size      Number of bits in the bitmap
+ * @return          Index of the bit, or size if there is none
+ */
+static inline size_t bitmap_findFirstSet(bitmap_t *b, size_t from, size_t size) {
+    return bitmap_scan(b, from, size, 0);
+}
+
+/**
+ * bitmap_findFirstZero
+ * Find the first clear bit at or after the given one.
+ *
+ * @param b         The bitmap
+ * @param from      Index to start from
+ * @param size      Number of bits in the bitmap
+ * @return          Index of the bit, or size if there is none
+ */
+static inline size_t bitmap_findFirstZero(bitmap_t *b, size_t from, size_t size) {
+    return bitmap_scan(b, from, size, ~(bitmap_t)0);
+}
+
+/**
+ * bitmap_findZeroRun
+ * Find the first run of len clear bits at or after the given one.
+ *
+ * @param b         The bitmap
+ * @param from      Index to start from
+ * @param size      Number of bits in the bitmap
+ * @param len       Length of the run, must not be zero
+ * @return          Index of the first bit of the run, or size if there is none
+ */
+static inline size_t bitmap_findZeroRun(bitmap_t *b, size_t from, size_t size, size_t len) {
+    size_t start = bitmap_findFirstZero(b, from, size);
+    while (start < size && size - start >= len) {
+        /* The run is broken by the first set bit, continue after it */
+        size_t end = bitmap_findFirstSet(b, start, start + len);
+        if (end == start + len) {
+            return start;
+        }
+        start = bitmap_findFirstZero(b, end, size);
+    }
+    return size;
+}
+
+/* Count set bits in a word without relying on a popcnt instruction */
+static inline size_t bitmap_wordPopcount(bitmap_t w) {
+    w = w - ((w >> 1) & 0x55555555);
+    w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+    w = (w + (w >> 4)) & 0x0F0F0F0F;
+    return (w * 0x01010101) >> 24;
+}
+
+/**
+ * bitmap_popcount
+ * Count the set bits of a bitmap.
+ *
+ * @param b         The bitmap
+ * @param size      Number of bits in the bitmap
+ * @return          Number of set bits
+ */
+static inline size_t bitmap_popcount(bitmap_t *b, size_t size) {
+    size_t count = 0;
+    size_t words = size / BITMAP_WORD_BITS;
+    for (size_t i = 0; i < words; i++) {
+        count += bitmap_wordPopcount(b[i]);
+    }
+    if (size % BITMAP_WORD_BITS) {
+        count += bitmap_wordPopcount(b[words] & bitmap_tailMask(size - 1));
+    }
+    return count;
 }
 
 #endif
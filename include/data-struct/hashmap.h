@@ -2,6 +2,7 @@
 #define DATA_STRUCT_HASHMAP_H
 
 #include "c/stdbool.h"
+#include "c-stdlib/malloc.h"
 
 typedef int (*comparator_t)(void *, void *);
 typedef int (*hash_t)(void *);
@@ -10,16 +11,27 @@ typedef struct {
     void *first;
     void *second;
 } pair_t;
+typedef struct {
+    hashmap_t *hm;
+    int index;
+    void *key;
+    void *value;
+} hashmap_iter_t;
 
 int string_hash(void *);
 int string_comparator(void *, void *);
 hashmap_t *hashmap_new_string(int size);
 hashmap_t *hashmap_new(hash_t, comparator_t, int);
+hashmap_t *hashmap_newTagged(enum malloc_tag, hash_t, comparator_t, int);
+void hashmap_reserve(hashmap_t *, int);
 bool hashmap_put(hashmap_t *, void *, void *);
 void *hashmap_get(hashmap_t *, void *);
 void *hashmap_remove(hashmap_t *, void *);
 void hashmap_dispose(hashmap_t *);
 pair_t *hashmap_iterator(hashmap_t *hm);
 pair_t *hashmap_next(pair_t *it);
+void hashmap_iterInit(hashmap_t *hm, hashmap_iter_t *it);
+bool hashmap_iterNext(hashmap_iter_t *it);
+void hashmap_forEach(hashmap_t *hm, void (*fn)(void *ctx, void *key, void *value), void *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+/**
+ * Header file for single-producer single-consumer ring buffer
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef DATA_STRUCT_RINGBUF_H
+#define DATA_STRUCT_RINGBUF_H
+
+#include "c/stddef.h"
+#include "c/stdint.h"
+#include "c/stdbool.h"
+
+/**
+ * ringbuf
+ * A fixed-capacity queue with one producer and one consumer, which may run
+ * in interrupt context or on different CPUs without a lock. The indices
+ * count items ever enqueued and dequeued and wrap around freely; only the
+ * producer writes tail and only the consumer writes head. They are kept on
+ * separate cache lines so the two sides do not contend.
+ *
+ * The structure is public so it can be placed statically, nothing in this
+ * module allocates memory.
+ */
+typedef struct {
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    uint32_t mask __attribute__((aligned(64)));
+    uint32_t elemSize;
+    void *buffer;
+} ringbuf_t;
+
+bool ringbuf_init(ringbuf_t *rb, void *buffer, size_t capacity, size_t elemSize);
+size_t ringbuf_enqueue(ringbuf_t *rb, const void *items, size_t count);
+size_t ringbuf_dequeue(ringbuf_t *rb, void *items, size_t count);
+size_t ringbuf_count(ringbuf_t *rb);
+
+static inline bool ringbuf_tryPush(ringbuf_t *rb, const void *item) {
+    return ringbuf_enqueue(rb, item, 1) == 1;
+}
+
+static inline bool ringbuf_tryPop(ringbuf_t *rb, void *item) {
+    return ringbuf_dequeue(rb, item, 1) == 1;
+}
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * Statically typed hashmaps generated by macro
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef DATA_STRUCT_TYPEDMAP_H
+#define DATA_STRUCT_TYPEDMAP_H
+
+#include "c/stddef.h"
+#include "c/stdint.h"
+#include "c/stdbool.h"
+#include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
+
+/**
+ * typedmap_stringHash
+ * Hash function for NUL-terminated string keys.
+ */
+static inline uint32_t typedmap_stringHash(const char *key) {
+    uint32_t h = 0;
+    while (*key != '\0') {
+        h = 31 * h + (unsigned char)*key++;
+    }
+    return h;
+}
+
+/**
+ * typedmap_stringEquals
+ * Equality function for NUL-terminated string keys.
+ */
+static inline bool typedmap_stringEquals(const char *a, const char *b) {
+    while (*a == *b) {
+        if (*a == '\0') {
+            return true;
+        }
+        a++;
+        b++;
+    }
+    return false;
+}
+
+/* Slots are picked by the low bits, so mix the high bits into them. The top
+ * bit marks the slot as used. */
+static inline uint32_t typedmap_mixHash(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash | 0x80000000;
+}
+
+/* Results of name##_put */
+enum typedmap_put_result {
+    /* Out of memory, the map is left unchanged */
+    TYPEDMAP_NOMEM,
+    TYPEDMAP_INSERTED,
+    /* The key was already present, its value is replaced */
+    TYPEDMAP_REPLACED
+};
+
+/**
+ * DEFINE_HASHMAP
+ * Define a hashmap type name##_t mapping key_t to val_t, together with its
+ * functions name##_init, name##_get, name##_put, name##_remove, name##_next
+ * and name##_dispose. hashfn(key) returns an uint32_t and eqfn(a, b) returns
+ * true for equal keys; both take keys by value and are called directly, so
+ * they are inlined into the probe loops.
+ *
+ * The layout is the same as hashmap_t: Robin Hood linear probing over a
+ * power of 2 sized table with a load factor up to 7/8. A zero-initialized
+ * map is empty and valid, its table is then accounted to MALLOC_TAG_DEFAULT.
+ */
+#define DEFINE_HASHMAP(name, key_t, val_t, hashfn, eqfn)                       \
+                                                                               \
+typedef struct {                                                               \
+    uint32_t hash;                                                             \
+    key_t key;                                                                 \
+    val_t value;                                                               \
+} name##_entry_t;                                                              \
+                                                                               \
+typedef struct {                                                               \
+    int count;                                                                 \
+    int size;                                                                  \
+    name##_entry_t *entries;                                                   \
+    enum malloc_tag tag;                                                       \
+} name##_t;                                                                    \
+                                                                               \
+static inline void name##_init(name##_t *map, enum malloc_tag tag) {           \
+    map->count = 0;                                                            \
+    map->size = 0;                                                             \
+    map->entries = NULL;                                                       \
+    map->tag = tag;                                                            \
+}                                                                              \
+                                                                               \
+static inline int name##_distance(name##_t *map, int slot) {                   \
+    return (slot - map->entries[slot].hash) & (map->size - 1);                 \
+}                                                                              \
+                                                                               \
+static inline int name##_findSlot(name##_t *map, key_t key, uint32_t hash) {   \
+    int mask = map->size - 1;                                                  \
+    int slot = hash & mask;                                                    \
+    for (int dist = 0;; dist++, slot = (slot + 1) & mask) {                    \
+        name##_entry_t *e = &map->entries[slot];                               \
+        if (e->hash == 0 || name##_distance(map, slot) < dist) {               \
+            return -1;                                                         \
+        }                                                                      \
+        if (e->hash == hash && eqfn(e->key, key)) {                            \
+            return slot;                                                       \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void name##_insert(name##_t *map, name##_entry_t entry) {        \
+    int mask = map->size - 1;                                                  \
+    int slot = entry.hash & mask;                                              \
+    for (int dist = 0;; dist++, slot = (slot + 1) & mask) {                    \
+        name##_entry_t *e = &map->entries[slot];                               \
+        if (e->hash == 0) {                                                    \
+            *e = entry;                                                        \
+            return;                                                            \
+        }                                                                      \
+        int other = name##_distance(map, slot);                                \
+        if (other < dist) {                                                    \
+            name##_entry_t displaced = *e;                                     \
+            *e = entry;                                                        \
+            entry = displaced;                                                 \
+            dist = other;                                                      \
+        }                                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline bool name##_resize(name##_t *map, int size) {                    \
+    name##_entry_t *old = map->entries;                                        \
+    int oldSize = map->size;                                                   \
+    name##_entry_t *entries =                                                  \
+        calloc_tagged(map->tag, size, sizeof(name##_entry_t));                 \
+    if (entries == NULL) {                                                     \
+        return false;                                                          \
+    }                                                                          \
+    map->entries = entries;                                                    \
+    map->size = size;                                                          \
+    for (int i = 0; i < oldSize; i++) {                                        \
+        if (old[i].hash) {                                                     \
+            name##_insert(map, old[i]);                                        \
+        }                                                                      \
+    }                                                                          \
+    free_tagged(map->tag, old);                                                \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Get a pointer to the value of the key, NULL if not found */                 \
+static inline val_t *name##_get(name##_t *map, key_t key) {                    \
+    if (map->count == 0) {                                                     \
+        return NULL;                                                           \
+    }                                                                          \
+    int slot = name##_findSlot(map, key, typedmap_mixHash(hashfn(key)));       \
+    return slot == -1 ? NULL : &map->entries[slot].value;                      \
+}                                                                              \
+                                                                               \
+/* Insert the key or replace its value, see enum typedmap_put_result */        \
+static inline enum typedmap_put_result                                         \
+name##_put(name##_t *map, key_t key, val_t value) {                            \
+    uint32_t hash = typedmap_mixHash(hashfn(key));                             \
+    if (map->count) {                                                          \
+        int slot = name##_findSlot(map, key, hash);                            \
+        if (slot != -1) {                                                      \
+            map->entries[slot].value = value;                                  \
+            return TYPEDMAP_REPLACED;                                          \
+        }                                                                      \
+    }                                                                          \
+    if (map->count + 1 > map->size / 8 * 7) {                                  \
+        if (!name##_resize(map, map->size ? map->size * 2 : 8)) {              \
+            return TYPEDMAP_NOMEM;                                             \
+        }                                                                      \
+    }                                                                          \
+    name##_entry_t entry = {                                                   \
+        .hash = hash,                                                          \
+        .key = key,                                                            \
+        .value = value                                                         \
+    };                                                                         \
+    name##_insert(map, entry);                                                 \
+    map->count++;                                                              \
+    return TYPEDMAP_INSERTED;                                                  \
+}                                                                              \
+                                                                               \
+/* Remove the key, its value is stored to out if it is not NULL */             \
+static inline bool name##_remove(name##_t *map, key_t key, val_t *out) {       \
+    if (map->count == 0) {                                                     \
+        return false;                                                          \
+    }                                                                          \
+    int slot = name##_findSlot(map, key, typedmap_mixHash(hashfn(key)));       \
+    if (slot == -1) {                                                          \
+        return false;                                                          \
+    }                                                                          \
+    if (out) {                                                                 \
+        *out = map->entries[slot].value;                                       \
+    }                                                                          \
+    /* Shift the following entries back instead of leaving a tombstone */      \
+    int mask = map->size - 1;                                                  \
+    for (int next = (slot + 1) & mask;                                         \
+            map->entries[next].hash && name##_distance(map, next) != 0;        \
+            slot = next, next = (next + 1) & mask) {                           \
+        map->entries[slot] = map->entries[next];                               \
+    }                                                                          \
+    map->entries[slot].hash = 0;                                               \
+    map->count--;                                                              \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Walk through the entries, start with *index = -1. Returns NULL at the end */\
+static inline name##_entry_t *name##_next(name##_t *map, int *index) {         \
+    while (++*index < map->size) {                                             \
+        if (map->entries[*index].hash) {                                       \
+            return &map->entries[*index];                                      \
+        }                                                                      \
+    }                                                                          \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+static inline void name##_dispose(name##_t *map) {                             \
+    free_tagged(map->tag, map->entries);                                       \
+    map->entries = NULL;                                                       \
+    map->size = 0;                                                             \
+    map->count = 0;                                                            \
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * Growable arrays generated by macro
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef DATA_STRUCT_VECTOR_H
+#define DATA_STRUCT_VECTOR_H
+
+#include "c/stddef.h"
+#include "c/stdbool.h"
+#include "c/assert.h"
+#include "c-stdlib/malloc.h"
+
+enum {
+    VECTOR_MIN_CAPACITY = 8
+};
+
+/**
+ * DEFINE_VECTOR
+ * Define a growable array type name##_t of elem_t, together with its
+ * functions name##_init, name##_reserve, name##_push, name##_pop,
+ * name##_shrink and name##_dispose. A zero-initialized vector is empty and
+ * valid, its memory is then accounted to MALLOC_TAG_DEFAULT.
+ *
+ * The capacity grows by half each time, so pushes are amortized constant
+ * time. Growing and shrinking go through realloc_tagged, which resizes the
+ * block in place when the memory after it is free.
+ */
+#define DEFINE_VECTOR(name, elem_t)                                            \
+                                                                               \
+typedef struct {                                                               \
+    elem_t *data;                                                              \
+    size_t length;                                                             \
+    size_t capacity;                                                           \
+    enum malloc_tag tag;                                                       \
+} name##_t;                                                                    \
+                                                                               \
+static inline void name##_init(name##_t *vec, enum malloc_tag tag) {           \
+    vec->data = NULL;                                                          \
+    vec->length = 0;                                                           \
+    vec->capacity = 0;                                                         \
+    vec->tag = tag;                                                            \
+}                                                                              \
+                                                                               \
+/* Resize the storage to exactly the given capacity */                         \
+static inline bool name##_setCapacity(name##_t *vec, size_t capacity) {        \
+    elem_t *data = NULL;                                                       \
+    if (capacity) {                                                            \
+        data = realloc_tagged(vec->tag, vec->data, capacity * sizeof(elem_t)); \
+        if (data == NULL) {                                                    \
+            return false;                                                      \
+        }                                                                      \
+    } else {                                                                   \
+        free_tagged(vec->tag, vec->data);                                      \
+    }                                                                          \
+    vec->data = data;                                                          \
+    vec->capacity = capacity;                                                  \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+/* Make room for at least count elements, false if out of memory */            \
+static inline bool name##_reserve(name##_t *vec, size_t count) {               \
+    if (count <= vec->capacity) {                                              \
+        return true;                                                           \
+    }                                                                          \
+    size_t capacity = vec->capacity + vec->capacity / 2;                       \
+    if (capacity < VECTOR_MIN_CAPACITY) {                                      \
+        capacity = VECTOR_MIN_CAPACITY;                                        \
+    }                                                                          \
+    if (capacity < count) {                                                    \
+        capacity = count;                                                      \
+    }                                                                          \
+    return name##_setCapacity(vec, capacity);                                  \
+}                                                                              \
+                                                                               \
+static inline bool name##_push(name##_t *vec, elem_t elem) {                   \
+    if (vec->length == vec->capacity &&                                        \
+            !name##_reserve(vec, vec->length + 1)) {                           \
+        return false;                                                          \
+    }                                                                          \
+    vec->data[vec->length++] = elem;                                           \
+    return true;                                                               \
+}                                                                              \
+                                                                               \
+static inline elem_t name##_pop(name##_t *vec) {                               \
+    assert(vec->length);                                                       \
+    return vec->data[--vec->length];                                           \
+}                                                                              \
+                                                                               \
+/* Give back the capacity beyond the length */                                 \
+static inline void name##_shrink(name##_t *vec) {                              \
+    if (vec->length < vec->capacity) {                                         \
+        name##_setCapacity(vec, vec->length);                                  \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static inline void name##_dispose(name##_t *vec) {                             \
+    free_tagged(vec->tag, vec->data);                                          \
+    name##_init(vec, vec->tag);                                                \
+}
+
+#endif
@@ -5,9 +5,12 @@
 #include "unicode/convert.h"
 #include "c/stdbool.h"
 #include "js/type.h"
+#include "data-struct/vector.h"
 
 typedef struct struct_lex lex_t;
 
+DEFINE_VECTOR(js_charbuf, uint16_t)
+
 struct struct_lex {
     uint16_t (*next)(lex_t *lex);
     uint16_t (*lookahead)(lex_t *lex);
@@ -18,21 +21,19 @@ struct struct_lex {
     bool strictMode;
     bool lineBefore;
     bool parseId;
+    /* Tokens are allocated from the arena, or the heap if NULL */
+    arena_t *arena;
     union {
-        struct {
-            uint16_t *buffer;
-            size_t size;
-            size_t length;
-        };
+        js_charbuf_t buffer;
         double number;
     } data;
 };
 
 typedef struct struct_grammar grammar_t;
 
-lex_t *lex_new(char *chr);
+lex_t *lex_new(char *chr, arena_t *arena);
 js_token_t *lex_next(lex_t *lex);
 
-grammar_t *grammar_new(lex_t *lex);
+grammar_t *grammar_new(lex_t *lex, arena_t *arena);
 
 #endif
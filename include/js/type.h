@@ -3,7 +3,10 @@
 
 #include "c/stdbool.h"
 #include "data-struct/hashmap.h"
+#include "data-struct/typedmap.h"
 #include "unicode/convert.h"
+#include "unicode/hash.h"
+#include "mem-alloc/arena.h"
 
 enum js_data_type_t {
     JS_NULL,
@@ -225,9 +228,19 @@ typedef struct js_property_t {
     js_data_t *configurable;
 } js_property_t;
 
+static inline uint32_t js_stringHash(js_string_t *str) {
+    return unicode_utf16KeyHash(str->value);
+}
+
+static inline bool js_stringEquals(js_string_t *x, js_string_t *y) {
+    return x == y || unicode_utf16KeyEquals(x->value, y->value);
+}
+
+DEFINE_HASHMAP(js_propmap, js_string_t *, js_property_t *, js_stringHash, js_stringEquals)
+
 struct js_object_t {
     js_data_t header;
-    hashmap_t *properties;
+    js_propmap_t properties;
     js_object_t *prototype;
     js_string_t *clazz;
     bool extensible;
@@ -345,11 +358,11 @@ js_object_t *js_allocObject(void);
 js_reference_t *js_allocReference(js_data_t *base, js_string_t *refName, bool strict);
 js_completion_t *js_allocCompletion(enum js_completion_type_t type);
 js_property_t *js_allocPropertyDesc(void);
-js_token_t *js_allocToken(enum js_token_type_t type);
-js_empty_node_t *js_allocEmptyNode(enum js_empty_node_type_t type);
-js_unary_node_t *js_allocUnaryNode(enum js_unary_node_type_t type);
-js_binary_node_t *js_allocBinaryNode(enum js_binary_node_type_t type);
-js_ternary_node_t *js_allocTernaryNode(enum js_ternary_node_type_t type);
+js_token_t *js_allocToken(arena_t *arena, enum js_token_type_t type);
+js_empty_node_t *js_allocEmptyNode(arena_t *arena, enum js_empty_node_type_t type);
+js_unary_node_t *js_allocUnaryNode(arena_t *arena, enum js_unary_node_type_t type);
+js_binary_node_t *js_allocBinaryNode(arena_t *arena, enum js_binary_node_type_t type);
+js_ternary_node_t *js_allocTernaryNode(arena_t *arena, enum js_ternary_node_type_t type);
 
 js_data_t *js_evalNode(js_context_t *context, js_data_t *node);
 
@@ -0,0 +1,31 @@
+/**
+ * Header file for arena allocator
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef MEM_ALLOC_ARENA_H
+#define MEM_ALLOC_ARENA_H
+
+#include "c/stddef.h"
+
+typedef struct struct_arena_t arena_t;
+
+/* Where an arena gets its chunks from, and gives them back to */
+typedef struct arena_source {
+    void *(*alloc)(struct arena_source *source, size_t size);
+    void (*free)(struct arena_source *source, void *addr);
+} arena_source_t;
+
+typedef struct {
+    void *chunk;
+    size_t ptr;
+} arena_mark_t;
+
+arena_t *arena_create(arena_source_t *source);
+void *arena_alloc(arena_t *arena, size_t size);
+arena_mark_t arena_mark(arena_t *arena);
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+void arena_destroy(arena_t *arena);
+
+#endif
@@ -10,12 +10,34 @@
 #include "c/stddef.h"
 #include "mem-alloc/pageman.h"
 
+#define ALLOCATOR_STAT_BUCKETS 32
+
 typedef struct struct_allocator_t allocator_t;
+
+typedef struct {
+    /* Bucket 0 counts blocks up to 8 bytes, bucket n counts blocks in (2^(n+2), 2^(n+3)] */
+    size_t allocs[ALLOCATOR_STAT_BUCKETS];
+    size_t frees[ALLOCATOR_STAT_BUCKETS];
+    size_t bytes[ALLOCATOR_STAT_BUCKETS];
+    /* Bytes in use, and the high-water mark of it */
+    size_t used;
+    size_t peak;
+    /* How allocations are served */
+    size_t exact;
+    size_t split;
+    size_t fresh;
+    size_t large;
+    /* Reallocations done without copying */
+    size_t inPlace;
+} allocator_stats_t;
+
 allocator_t *allocator_create(pageman_t *man);
 void allocator_free(allocator_t *al, void *addr);
 void *allocator_malloc(allocator_t *al, size_t size);
 void *allocator_calloc(allocator_t *al, size_t nmemb, size_t size);
 void *allocator_realloc(allocator_t *al, void *addr, size_t size);
 void *allocator_aligned_alloc(allocator_t *al, size_t alignment, size_t size);
+size_t allocator_usableSize(allocator_t *al, void *addr);
+void allocator_getStats(allocator_t *al, allocator_stats_t *stats);
 
 #endif
\ No newline at end of file
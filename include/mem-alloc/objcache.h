@@ -0,0 +1,19 @@
+/**
+ * Header file for object cache
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef MEM_ALLOC_OBJCACHE_H
+#define MEM_ALLOC_OBJCACHE_H
+
+#include "c/stddef.h"
+#include "mem-alloc/pageman.h"
+
+typedef struct struct_objcache_t objcache_t;
+objcache_t *objcache_create(pageman_t *man, const char *name, size_t size, size_t align, void (*ctor)(void *));
+void *objcache_alloc(objcache_t *cache);
+void objcache_free(objcache_t *cache, void *obj);
+size_t objcache_getPages(objcache_t *cache);
+
+#endif
@@ -8,12 +8,44 @@
 #define MEM_ALLOC_PAGEMAN_H
 
 #include "c/stddef.h"
+#include "c/stdbool.h"
+
+#define PAGEMAN_TOTAL_LEVEL 18
 
 typedef struct struct_pageman_t pageman_t;
+
+typedef struct {
+    /* Bytes currently free, and bytes managed in total */
+    size_t spare;
+    size_t total;
+    /* Free bytes known to be zero */
+    size_t zero;
+    /* Bytes handed out, and the high-water mark of it */
+    size_t used;
+    size_t peak;
+    /* Allocations and frees on each order */
+    size_t allocs[PAGEMAN_TOTAL_LEVEL];
+    size_t frees[PAGEMAN_TOTAL_LEVEL];
+    /* Blocks on the free list of each order */
+    size_t freeBlocks[PAGEMAN_TOTAL_LEVEL];
+    /* Percentage of free memory unusable for a request of each order */
+    size_t unusable[PAGEMAN_TOTAL_LEVEL];
+} pageman_stats_t;
+
 pageman_t *pageman_create(void *base, size_t limit, void *firstAval, size_t firstSize);
+void pageman_addZone(pageman_t *bpm, pageman_t *zone);
 void pageman_free(pageman_t *bpm, void *addr, size_t size);
 void *pageman_alloc(pageman_t *bpm, size_t size);
+void *pageman_allocZeroed(pageman_t *bpm, size_t size);
+size_t pageman_allocBatch(pageman_t *bpm, size_t size, size_t count, void **out);
+void pageman_freeBatch(pageman_t *bpm, size_t size, size_t count, void **blocks);
+void *pageman_allocPages(pageman_t *bpm, size_t pages);
+void *pageman_allocPagesZeroed(pageman_t *bpm, size_t pages);
+void pageman_freePages(pageman_t *bpm, void *addr, size_t pages);
+bool pageman_extendPages(pageman_t *bpm, void *addr, size_t pages, size_t newPages);
 void pageman_freeBlock(pageman_t *bpm, void *addr, size_t size);
 size_t pageman_spare(pageman_t *bpm);
+size_t pageman_zeroIdle(pageman_t *bpm, size_t budget);
+void pageman_getStats(pageman_t *bpm, pageman_stats_t *stats);
 
 #endif
\ No newline at end of file
@@ -1,6 +1,48 @@
+/**
+ * Provide hash functions for unicode strings
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef UNICODE_HASH_H
+#define UNICODE_HASH_H
+
+#include "c/stdint.h"
+#include "c/stdbool.h"
 
 #include "data-struct/hashmap.h"
+#include "unicode/convert.h"
 
 int unicode_utf16Cmp(void *s1, void *s2);
 int unicode_utf16Hash(void *key);
-hashmap_t *hashmap_new_utf16(int size);
\ No newline at end of file
+hashmap_t *hashmap_new_utf16(int size);
+
+/**
+ * unicode_utf16KeyHash
+ * Hash function for UTF-16 keys of DEFINE_HASHMAP.
+ */
+static inline uint32_t unicode_utf16KeyHash(utf16_string_t key) {
+    uint32_t h = 0;
+    for (size_t i = 0; i < key.len; i++) {
+        h = 31 * h + key.str[i];
+    }
+    return h;
+}
+
+/**
+ * unicode_utf16KeyEquals
+ * Equality function for UTF-16 keys of DEFINE_HASHMAP.
+ */
+static inline bool unicode_utf16KeyEquals(utf16_string_t a, utf16_string_t b) {
+    if (a.len != b.len) {
+        return false;
+    }
+    for (size_t i = 0; i < a.len; i++) {
+        if (a.str[i] != b.str[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -15,6 +15,12 @@ static inline size_t log2(size_t num) {
     return ret;
 }
 
+static inline size_t lowestBit(size_t num) {
+    size_t ret;
+    __asm__ __volatile__("bsf %1, %0":"=r"(ret):"r"(num):"cc");
+    return ret;
+}
+
 #endif
 
 
@@ -5,40 +5,196 @@
  */
 
 #include "c/assert.h"
+#include "c/stdio.h"
+#include "c/string.h"
 #include "c-stdlib/malloc.h"
 #include "mem-alloc/blockalloc.h"
 
+static pageman_t *pageman = NULL;
 static allocator_t *allocator = NULL;
 
+#ifndef NSTATS
+static const char *tagName[MALLOC_TAG_COUNT] = {
+    [MALLOC_TAG_DEFAULT] = "default",
+    [MALLOC_TAG_VFS] = "vfs",
+    [MALLOC_TAG_ELF] = "elf",
+    [MALLOC_TAG_JS] = "js"
+};
+
+static struct {
+    size_t bytes;
+    size_t count;
+    size_t peak;
+} tagStats[MALLOC_TAG_COUNT];
+
+static void tagAlloc(enum malloc_tag tag, void *addr) {
+    tagStats[tag].bytes += allocator_usableSize(allocator, addr);
+    tagStats[tag].count++;
+    if (tagStats[tag].bytes > tagStats[tag].peak) {
+        tagStats[tag].peak = tagStats[tag].bytes;
+    }
+}
+
+static void tagFree(enum malloc_tag tag, void *addr) {
+    if (addr) {
+        tagStats[tag].bytes -= allocator_usableSize(allocator, addr);
+        tagStats[tag].count--;
+    }
+}
+
+/* Object caches take pages straight from the page manager, so remember the
+ * tag of each to count their pages in the dump */
+typedef struct struct_cache_tag_t {
+    struct struct_cache_tag_t *next;
+    objcache_t *cache;
+    enum malloc_tag tag;
+} cache_tag_t;
+
+static cache_tag_t *cacheTags = NULL;
+
+static void tagCache(enum malloc_tag tag, objcache_t *cache) {
+    cache_tag_t *entry = allocator_malloc(allocator, sizeof(cache_tag_t));
+    assert(entry);
+    entry->next = cacheTags;
+    entry->cache = cache;
+    entry->tag = tag;
+    cacheTags = entry;
+}
+#else
+static inline void tagAlloc(enum malloc_tag tag, void *addr) {}
+static inline void tagFree(enum malloc_tag tag, void *addr) {}
+static inline void tagCache(enum malloc_tag tag, objcache_t *cache) {}
+#endif
+
+/* Arena chunks are allocated with the tag of the arena */
+typedef struct {
+    arena_source_t source;
+    enum malloc_tag tag;
+} arena_tag_t;
+
+static void *allocChunk(arena_source_t *source, size_t size) {
+    return malloc_tagged(((arena_tag_t *)source)->tag, size);
+}
+
+static void freeChunk(arena_source_t *source, void *addr) {
+    free_tagged(((arena_tag_t *)source)->tag, addr);
+}
+
+static arena_tag_t arenaTags[MALLOC_TAG_COUNT];
+
 void init_allocator(pageman_t *man) {
+    pageman = man;
     allocator = allocator_create(man);
     assert(allocator != NULL);
+    for (int i = 0; i < MALLOC_TAG_COUNT; i++) {
+        arenaTags[i].source.alloc = allocChunk;
+        arenaTags[i].source.free = freeChunk;
+        arenaTags[i].tag = i;
+    }
 }
 
-void free(void *addr) {
-    allocator_free(allocator, addr);
+objcache_t *objcache_new(enum malloc_tag tag, const char *name, size_t size, size_t align, void (*ctor)(void *)) {
+    objcache_t *ret = objcache_create(pageman, name, size, align, ctor);
+    assert(ret);
+    tagCache(tag, ret);
+    return ret;
 }
 
-void *malloc(size_t size) {
+/* The arena and its chunks are charged to the tag */
+arena_t *arena_new(enum malloc_tag tag) {
+    arena_t *ret = arena_create(&arenaTags[tag].source);
+    assert(ret);
+    return ret;
+}
+
+void malloc_getStats(allocator_stats_t *stats) {
+    allocator_getStats(allocator, stats);
+}
+
+/* Memory allocated with a tag must be freed with the same tag */
+void *malloc_tagged(enum malloc_tag tag, size_t size) {
     void *ret = allocator_malloc(allocator, size);
     assert(ret);
+    tagAlloc(tag, ret);
     return ret;
 }
 
-void *calloc(size_t nmemb, size_t size) {
+void *calloc_tagged(enum malloc_tag tag, size_t nmemb, size_t size) {
     void *ret = allocator_calloc(allocator, nmemb, size);
     assert(ret);
+    tagAlloc(tag, ret);
     return ret;
 }
 
-void *realloc(void *addr, size_t size) {
+void *realloc_tagged(enum malloc_tag tag, void *addr, size_t size) {
+    tagFree(tag, addr);
     void *ret = allocator_realloc(allocator, addr, size);
     assert(ret);
+    tagAlloc(tag, ret);
+    return ret;
+}
+
+void free_tagged(enum malloc_tag tag, void *addr) {
+    tagFree(tag, addr);
+    allocator_free(allocator, addr);
+}
+
+/* Tagged versions of strdup and strndup */
+char *strdup_tagged(enum malloc_tag tag, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *ret = malloc_tagged(tag, len);
+    memcpy(ret, s, len);
+    return ret;
+}
+
+char *strndup_tagged(enum malloc_tag tag, const char *s, size_t n) {
+    size_t len = strnlen(s, n);
+    char *ret = malloc_tagged(tag, len + 1);
+    memcpy(ret, s, len);
+    ret[len] = 0;
     return ret;
 }
 
+void malloc_dumpTags(void) {
+#ifndef NSTATS
+    for (int i = 0; i < MALLOC_TAG_COUNT; i++) {
+        size_t pages = 0;
+        for (cache_tag_t *entry = cacheTags; entry; entry = entry->next) {
+            if (entry->tag == (enum malloc_tag)i) {
+                pages += objcache_getPages(entry->cache);
+            }
+        }
+        printf("[INFO] [MEM]: %-8s %d blocks, %d KiB live, %d KiB peak, %d KiB in caches\n",
+               tagName[i], tagStats[i].count, tagStats[i].bytes / 1024, tagStats[i].peak / 1024,
+               pages * 4096 / 1024);
+    }
+#endif
+}
+
+/* Called while waiting for devices, clear a page of free memory in advance */
+void malloc_idle(void) {
+    pageman_zeroIdle(pageman, 4096);
+}
+
+void free(void *addr) {
+    free_tagged(MALLOC_TAG_DEFAULT, addr);
+}
+
+void *malloc(size_t size) {
+    return malloc_tagged(MALLOC_TAG_DEFAULT, size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    return calloc_tagged(MALLOC_TAG_DEFAULT, nmemb, size);
+}
+
+void *realloc(void *addr, size_t size) {
+    return realloc_tagged(MALLOC_TAG_DEFAULT, addr, size);
+}
+
 void *aligned_alloc(size_t alignment, size_t size) {
     void *ret = allocator_aligned_alloc(allocator, alignment, size);
     assert(ret);
+    tagAlloc(MALLOC_TAG_DEFAULT, ret);
     return ret;
 }
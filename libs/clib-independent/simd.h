@@ -0,0 +1,24 @@
+/**
+ * Kernels selected by string_initSimd, see simd.inc
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef CLIB_INDEPENDENT_SIMD_H
+#define CLIB_INDEPENDENT_SIMD_H
+
+#include "c/stddef.h"
+
+void *sse2_memcpy(void *restrict dest, const void *restrict src, size_t count);
+void *sse2_memset(void *dest, int val, size_t count);
+int sse2_memcmp(const void *s1, const void *s2, size_t n);
+size_t sse2_strlen(const char *str);
+void *sse2_memchr(const void *s, int c, size_t n);
+
+void *avx2_memcpy(void *restrict dest, const void *restrict src, size_t count);
+void *avx2_memset(void *dest, int val, size_t count);
+int avx2_memcmp(const void *s1, const void *s2, size_t n);
+size_t avx2_strlen(const char *str);
+void *avx2_memchr(const void *s, int c, size_t n);
+
+#endif
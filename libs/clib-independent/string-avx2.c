@@ -0,0 +1,14 @@
+/**
+ * AVX2 memory and string kernels, built with -mavx2 and only called after
+ * string_initSimd has found AVX2 usable
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include "simd.h"
+
+#define VEC_SIZE 32
+#define movemask(v) ((uint32_t)__builtin_ia32_pmovmskb256(v))
+#define SIMD(name) avx2_##name
+
+#include "simd.inc"
@@ -0,0 +1,14 @@
+/**
+ * SSE2 memory and string kernels, built with -msse2 and only called after
+ * string_initSimd has found SSE2 usable
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include "simd.h"
+
+#define VEC_SIZE 16
+#define movemask(v) ((uint32_t)__builtin_ia32_pmovmskb128(v))
+#define SIMD(name) sse2_##name
+
+#include "simd.inc"
@@ -8,51 +8,171 @@
 #include "c/stddef.h"
 #include "c/string.h"
 #include "c/stdlib.h"
+#include "c/stdbool.h"
 
-void *memcpy(void *restrict dest, const void *restrict src, size_t count) {
-    char *d = dest;
-    const char *s = src;
-    for (size_t i = 0; i < count; i++, d++, s++) {
-        *d = *s;
+#include "asm/cpu.h"
+
+#include "util/log2.h"
+
+#include "simd.h"
+
+/* Words may be read from any address, x86 handles unaligned loads */
+typedef uint32_t __attribute__((may_alias, aligned(1))) word_t;
+
+enum {
+    WORD_SIZE = sizeof(uint32_t),
+    /* Below this, aligning the destination costs more than it saves */
+    WORD_THRESHOLD = 16,
+    /* From this size, the startup cost of rep movsd/stosd pays off */
+    REP_THRESHOLD = 256,
+    /* A load which stays inside a page holding a valid byte never faults */
+    PAGE_SIZE = 4096
+};
+
+/* Non-zero if any byte of the word is zero. The lowest set bit is always
+ * in the first zero byte, higher ones may be false positives. */
+static inline uint32_t hasZero(uint32_t word) {
+    return (word - 0x01010101U) & ~word & 0x80808080U;
+}
+
+/* Index of the first zero byte of a word known to contain one */
+static inline size_t firstZero(uint32_t word) {
+    return lowestBit(hasZero(word)) / 8;
+}
+
+static inline void repMovsd(void *dest, const void *src, size_t words) {
+    __asm__ __volatile__("rep movsl":"+D"(dest), "+S"(src), "+c"(words)::"memory");
+}
+
+static inline void repStosd(void *dest, uint32_t val, size_t words) {
+    __asm__ __volatile__("rep stosl":"+D"(dest), "+c"(words):"a"(val):"memory");
+}
+
+/* Copy from low to high addresses, so overlapping moves to a lower address
+ * are safe as well. The destination is aligned first since stores crossing
+ * words are more expensive than loads. */
+static void copyForward(char *d, const char *s, size_t count) {
+    if (count >= WORD_THRESHOLD) {
+        size_t head = -(size_t)d & (WORD_SIZE - 1);
+        count -= head;
+        for (; head; head--) {
+            *d++ = *s++;
+        }
+        size_t words = count / WORD_SIZE;
+        if (count >= REP_THRESHOLD) {
+            repMovsd(d, s, words);
+        } else {
+            for (size_t i = 0; i < words; i++) {
+                ((word_t *)d)[i] = ((const word_t *)s)[i];
+            }
+        }
+        d += words * WORD_SIZE;
+        s += words * WORD_SIZE;
+        count %= WORD_SIZE;
+    }
+    for (; count; count--) {
+        *d++ = *s++;
     }
+}
+
+/* Copy from high to low addresses, for moves to a higher address. rep movsd
+ * with the direction flag set is slow on most processors, so only the word
+ * loop is used. */
+static void copyBackward(char *d, const char *s, size_t count) {
+    d += count;
+    s += count;
+    if (count >= WORD_THRESHOLD) {
+        size_t tail = (size_t)d & (WORD_SIZE - 1);
+        count -= tail;
+        for (; tail; tail--) {
+            *--d = *--s;
+        }
+        for (; count >= WORD_SIZE; count -= WORD_SIZE) {
+            d -= WORD_SIZE;
+            s -= WORD_SIZE;
+            *(word_t *)d = *(const word_t *)s;
+        }
+    }
+    for (; count; count--) {
+        *--d = *--s;
+    }
+}
+
+static void *memcpyScalar(void *restrict dest, const void *restrict src, size_t count) {
+    copyForward(dest, src, count);
     return dest;
 }
 
 void *memmove(void *dest, const void *src, size_t count) {
-    if ((size_t)dest < (size_t)src || (size_t)dest > (size_t)src + count) {
-        char *d = dest;
-        const char *s = src;
-        for (size_t i = 0; i < count; i++, d++, s++) {
-            *d = *s;
-        }
+    if ((size_t)dest + count <= (size_t)src || (size_t)dest >= (size_t)src + count) {
+        memcpy(dest, src, count);
+    } else if ((size_t)dest <= (size_t)src) {
+        copyForward(dest, src, count);
     } else {
-        char *d = dest + count;
-        const char *s = src + count;
-        for (size_t i = 0; i < count; i++, d--, s--) {
-            *d = *s;
-        }
+        copyBackward(dest, src, count);
     }
     return dest;
 }
 
-void *memset(void *dest, int val, size_t count) {
-    void *ptr = dest;
-    for (ptr = dest; count; ptr++, count--) {
-        *(char *)ptr = val;
+static void *memsetScalar(void *dest, int val, size_t count) {
+    char *d = dest;
+    if (count >= WORD_THRESHOLD) {
+        uint32_t word = (unsigned char)val * 0x01010101U;
+        size_t head = -(size_t)d & (WORD_SIZE - 1);
+        count -= head;
+        for (; head; head--) {
+            *d++ = val;
+        }
+        size_t words = count / WORD_SIZE;
+        if (count >= REP_THRESHOLD) {
+            repStosd(d, word, words);
+        } else {
+            for (size_t i = 0; i < words; i++) {
+                ((word_t *)d)[i] = word;
+            }
+        }
+        d += words * WORD_SIZE;
+        count %= WORD_SIZE;
+    }
+    for (; count; count--) {
+        *d++ = val;
     }
     return dest;
 }
 
-size_t strlen(const char *str) {
-    size_t counter = 0;
-    for (; *str; counter++, str++);
-    return counter;
+/* The string functions below check bytes one by one until the pointer is
+ * aligned, then 4 bytes per step. An aligned word never crosses a page, so
+ * reading past the terminator is safe. */
+
+static size_t strlenScalar(const char *str) {
+    const char *p = str;
+    for (; (size_t)p & (WORD_SIZE - 1); p++) {
+        if (*p == 0) {
+            return p - str;
+        }
+    }
+    uint32_t word;
+    while (!hasZero(word = *(const word_t *)p)) {
+        p += WORD_SIZE;
+    }
+    return p + firstZero(word) - str;
 }
 
 size_t strnlen(const char *str, size_t maxlen) {
-    size_t counter = 0;
-    for (; *str && counter < maxlen; counter++, str++);
-    return counter;
+    const char *p = str;
+    for (; maxlen && ((size_t)p & (WORD_SIZE - 1)); p++, maxlen--) {
+        if (*p == 0) {
+            return p - str;
+        }
+    }
+    for (; maxlen >= WORD_SIZE; p += WORD_SIZE, maxlen -= WORD_SIZE) {
+        uint32_t word = *(const word_t *)p;
+        if (hasZero(word)) {
+            return p + firstZero(word) - str;
+        }
+    }
+    for (; maxlen && *p; p++, maxlen--);
+    return p - str;
 }
 
 /**
@@ -68,10 +188,8 @@ char *strdup(const char *s) {
 }
 
 char *strndup(const char *s, size_t n) {
-    size_t len = strlen(s);
-    if (len > n) {
-        len = n;
-    }
+    /* s needs no terminator within the first n bytes */
+    size_t len = strnlen(s, n);
     char *ret = malloc(len + 1);
     memcpy(ret, s, len);
     ret[len] = 0;
@@ -79,22 +197,145 @@ char *strndup(const char *s, size_t n) {
 }
 
 int strcmp(const char *s1, const char *s2) {
-    for (; *s2 != 0; s1++, s2++) {
-        int diff = *s1 - *s2;
-        if (diff != 0) {
+    const unsigned char *p1 = (const unsigned char *)s1;
+    const unsigned char *p2 = (const unsigned char *)s2;
+    for (;;) {
+        /* The two strings are rarely aligned alike, so words are loaded
+         * unaligned, as many as fit before either reaches a page end */
+        size_t room1 = PAGE_SIZE - ((size_t)p1 & (PAGE_SIZE - 1));
+        size_t room2 = PAGE_SIZE - ((size_t)p2 & (PAGE_SIZE - 1));
+        size_t words = (room1 < room2 ? room1 : room2) / WORD_SIZE;
+        for (; words; words--, p1 += WORD_SIZE, p2 += WORD_SIZE) {
+            uint32_t word = *(const word_t *)p1;
+            /* The lowest set bit is in the first byte which differs or ends s1 */
+            uint32_t stop = (word ^ *(const word_t *)p2) | hasZero(word);
+            if (stop) {
+                size_t i = lowestBit(stop) / 8;
+                return p1[i] - p2[i];
+            }
+        }
+        /* A word would cross a page, step over one byte instead */
+        int diff = *p1 - *p2;
+        if (diff != 0 || *p1 == 0) {
             return diff;
         }
+        p1++;
+        p2++;
     }
-    return *s1;
 }
 
-int memcmp(const void *s1, const void *s2, size_t n) {
-    const char *p1 = s1, *p2 = s2;
-    for (size_t i = 0; i < n; i++, p1++, p2++) {
+static int memcmpScalar(const void *s1, const void *s2, size_t n) {
+    const unsigned char *p1 = s1, *p2 = s2;
+    /* Both ranges are valid, so words are loaded from any alignment */
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, p1 += WORD_SIZE, p2 += WORD_SIZE) {
+        if (*(const word_t *)p1 != *(const word_t *)p2) {
+            break;
+        }
+    }
+    for (; n; n--, p1++, p2++) {
         int diff = *p1 - *p2;
         if (diff != 0) {
             return diff;
         }
     }
     return 0;
+}
+
+static void *memchrScalar(const void *s, int c, size_t n) {
+    const unsigned char *p = s;
+    for (; n && ((size_t)p & (WORD_SIZE - 1)); n--, p++) {
+        if (*p == (unsigned char)c) {
+            return (void *)p;
+        }
+    }
+    /* Bytes equal to c become zero */
+    uint32_t pattern = (unsigned char)c * 0x01010101U;
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, p += WORD_SIZE) {
+        uint32_t word = *(const word_t *)p ^ pattern;
+        if (hasZero(word)) {
+            return (void *)(p + firstZero(word));
+        }
+    }
+    for (; n; n--, p++) {
+        if (*p == (unsigned char)c) {
+            return (void *)p;
+        }
+    }
+    return NULL;
+}
+
+/* The functions below go through this table. It starts with the scalar
+ * versions, and string_initSimd may switch it to SIMD kernels. */
+static struct {
+    void *(*memcpy)(void *restrict dest, const void *restrict src, size_t count);
+    void *(*memset)(void *dest, int val, size_t count);
+    int (*memcmp)(const void *s1, const void *s2, size_t n);
+    size_t (*strlen)(const char *str);
+    void *(*memchr)(const void *s, int c, size_t n);
+} impl = {
+    memcpyScalar,
+    memsetScalar,
+    memcmpScalar,
+    strlenScalar,
+    memchrScalar
+};
+
+void *memcpy(void *restrict dest, const void *restrict src, size_t count) {
+    return impl.memcpy(dest, src, count);
+}
+
+void *memset(void *dest, int val, size_t count) {
+    return impl.memset(dest, val, count);
+}
+
+int memcmp(const void *s1, const void *s2, size_t n) {
+    return impl.memcmp(s1, s2, n);
+}
+
+size_t strlen(const char *str) {
+    return impl.strlen(str);
+}
+
+void *memchr(const void *s, int c, size_t n) {
+    return impl.memchr(s, c, n);
+}
+
+/**
+ * string_initSimd
+ * Switch memcpy, memset, memcmp, strlen and memchr to SSE2 or AVX2 kernels
+ * when the processor has them and their register state has been enabled
+ * through CR4 and XCR0. Must run in ring 0, since CR4 is read.
+ *
+ * The kernels use XMM and YMM registers without saving them. After this
+ * call, these functions are unsafe in interrupt handlers unless the handler
+ * saves the vector state, and every CPU calling them must have the state
+ * enabled.
+ */
+void string_initSimd(void) {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    cpuid(1, 0, regs);
+    if (!(regs[3] & CPUID_EDX_SSE2) || !(readCR4() & CR4_OSFXSR)) {
+        return;
+    }
+    impl.memcpy = sse2_memcpy;
+    impl.memset = sse2_memset;
+    impl.memcmp = sse2_memcmp;
+    impl.strlen = sse2_strlen;
+    impl.memchr = sse2_memchr;
+
+    bool avx = (regs[2] & CPUID_ECX_OSXSAVE) && (regs[2] & CPUID_ECX_AVX) &&
+               (readXCR0() & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX);
+    if (!avx || maxLeaf < 7) {
+        return;
+    }
+    cpuid(7, 0, regs);
+    if (regs[1] & CPUID_EBX_AVX2) {
+        impl.memcpy = avx2_memcpy;
+        impl.memset = avx2_memset;
+        impl.memcmp = avx2_memcmp;
+        impl.strlen = avx2_strlen;
+        impl.memchr = avx2_memchr;
+    }
 }
\ No newline at end of file
@@ -1,30 +1,46 @@
 #include "c/string.h"
 #include "c/stdlib.h"
 #include "c/stdint.h"
+#include "c/assert.h"
+#include "c-stdlib/malloc.h"
 
 #include "data-struct/hashmap.h"
 
-typedef struct str_node {
-    int hash;
+/* Entries are stored in a flat array with Robin Hood linear probing: an
+ * entry far from its home slot takes the place of one closer to home, so
+ * a lookup can stop as soon as it passes where its key would have been. */
+typedef struct {
+    /* Zero if the slot is empty, otherwise the hash with the top bit set */
+    uint32_t hash;
     void *key;
     void *data;
-    struct str_node *next;
-} node_t;
+} entry_t;
+
+enum {
+    /* Marks a slot of the old table whose entry is gone */
+    TOMBSTONE = 1,
+    MIN_SIZE = 8,
+    /* Slots of the old table moved on each change while resizing */
+    MIGRATE_STEP = 8
+};
 
+/* When resizing, the old table is drained a few slots on each change
+ * instead of all at once. Until then, lookups check both tables. */
 struct str_hashmap {
     comparator_t compare;
     hash_t hash;
+    int count;
+    /* Number of slots, always a power of 2 */
     int size;
-    node_t *node[0];
+    entry_t *entries;
+    int oldSize;
+    entry_t *old;
+    /* Slots before this one in the old table have been moved */
+    int migrate;
+    /* The tables and the hashmap itself are accounted to this tag */
+    enum malloc_tag tag;
 };
 
-typedef struct {
-    pair_t kp;
-    hashmap_t *hm;
-    int index;
-    node_t *next;
-} iterator_t;
-
 int string_comparator(void *a, void *b) {
     return strcmp(a, b);
 }
@@ -42,111 +58,326 @@ hashmap_t *hashmap_new_string(int size) {
     return hashmap_new(string_hash, string_comparator, size);
 }
 
-hashmap_t *hashmap_new(hash_t h, comparator_t c, int size) {
-    hashmap_t *hm = malloc(sizeof(hashmap_t) + sizeof(node_t *)*size);
+static inline uint32_t getHash(hashmap_t *hm, void *key) {
+    /* Slots are picked by the low bits, so mix the high bits into them */
+    uint32_t hash = hm->hash(key);
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash | 0x80000000;
+}
+
+static inline int getHome(hashmap_t *hm, uint32_t hash) {
+    return hash & (hm->size - 1);
+}
+
+/* Number of slots between the entry in the slot and its home slot */
+static inline int getDistance(hashmap_t *hm, int slot) {
+    return (slot - getHome(hm, hm->entries[slot].hash)) & (hm->size - 1);
+}
+
+static inline int nextSlot(hashmap_t *hm, int slot) {
+    return (slot + 1) & (hm->size - 1);
+}
+
+static inline int roundSize(int count) {
+    /* Leave room for the load factor of 7/8 */
+    int size = MIN_SIZE;
+    while (size / 8 * 7 < count) {
+        size *= 2;
+    }
+    return size;
+}
+
+/* Find the slot holding the key in the current table, -1 if not found */
+static int findSlot(hashmap_t *hm, void *key, uint32_t hash) {
+    int slot = getHome(hm, hash);
+    for (int dist = 0;; dist++, slot = nextSlot(hm, slot)) {
+        entry_t *e = &hm->entries[slot];
+        if (e->hash == 0 || getDistance(hm, slot) < dist) {
+            return -1;
+        }
+        if (e->hash == hash && hm->compare(e->key, key) == 0) {
+            return slot;
+        }
+    }
+}
+
+/* Find the key in the old table. Entries are only removed from it by
+ * tombstones, so plain linear probing is used. */
+static entry_t *findOld(hashmap_t *hm, void *key, uint32_t hash) {
+    if (hm->old == NULL) {
+        return NULL;
+    }
+    int mask = hm->oldSize - 1;
+    for (int slot = hash & mask;; slot = (slot + 1) & mask) {
+        entry_t *e = &hm->old[slot];
+        if (e->hash == 0) {
+            return NULL;
+        }
+        if (e->hash == hash && hm->compare(e->key, key) == 0) {
+            return e;
+        }
+    }
+}
+
+/* Find the entry of the key in either table */
+static entry_t *findEntry(hashmap_t *hm, void *key) {
+    uint32_t hash = getHash(hm, key);
+    int slot = findSlot(hm, key, hash);
+    if (slot != -1) {
+        return &hm->entries[slot];
+    }
+    return findOld(hm, key, hash);
+}
+
+/* Insert an entry whose key is known to be absent */
+static void insertEntry(hashmap_t *hm, entry_t entry) {
+    int slot = getHome(hm, entry.hash);
+    for (int dist = 0;; dist++, slot = nextSlot(hm, slot)) {
+        entry_t *e = &hm->entries[slot];
+        if (e->hash == 0) {
+            *e = entry;
+            return;
+        }
+        int other = getDistance(hm, slot);
+        if (other < dist) {
+            entry_t displaced = *e;
+            *e = entry;
+            entry = displaced;
+            dist = other;
+        }
+    }
+}
+
+/* Move some slots of the old table into the current one */
+static void migrate(hashmap_t *hm, int step) {
+    if (hm->old == NULL) {
+        return;
+    }
+    for (; step && hm->migrate < hm->oldSize; step--, hm->migrate++) {
+        entry_t *e = &hm->old[hm->migrate];
+        if (e->hash & 0x80000000) {
+            insertEntry(hm, *e);
+            e->hash = TOMBSTONE;
+        }
+    }
+    if (hm->migrate == hm->oldSize) {
+        free_tagged(hm->tag, hm->old);
+        hm->old = NULL;
+        hm->oldSize = 0;
+    }
+}
+
+/* Switch to a new table, the entries are moved over later */
+static void resize(hashmap_t *hm, int size) {
+    /* Only one old table is kept, so finish the last resizing first */
+    migrate(hm, hm->oldSize);
+    hm->old = hm->entries;
+    hm->oldSize = hm->size;
+    hm->migrate = 0;
+    hm->entries = calloc_tagged(hm->tag, size, sizeof(entry_t));
+    hm->size = size;
+}
+
+/**
+ * hashmap_newTagged
+ * Create a hashmap whose memory is accounted to the given tag.
+ *
+ * @param tag       The tag to allocate with
+ * @param h         Hash function of the keys
+ * @param c         Comparator of the keys, returns 0 for equal keys
+ * @param size      Number of slots to start with
+ * @return          The new hashmap
+ */
+hashmap_t *hashmap_newTagged(enum malloc_tag tag, hash_t h, comparator_t c, int size) {
+    hashmap_t *hm = malloc_tagged(tag, sizeof(hashmap_t));
+    hm->tag = tag;
     hm->compare = c;
     hm->hash = h;
-    hm->size = size;
-    int i;
-    for (i = 0; i < size; i++) {
-        hm->node[i] = NULL;
+    hm->count = 0;
+    hm->size = MIN_SIZE;
+    while (hm->size < size) {
+        hm->size *= 2;
     }
+    hm->entries = calloc_tagged(tag, hm->size, sizeof(entry_t));
+    hm->old = NULL;
+    hm->oldSize = 0;
+    hm->migrate = 0;
     return hm;
 }
 
+hashmap_t *hashmap_new(hash_t h, comparator_t c, int size) {
+    return hashmap_newTagged(MALLOC_TAG_DEFAULT, h, c, size);
+}
+
+/**
+ * hashmap_reserve
+ * Make room for the given number of entries, so that inserting them
+ * does not trigger resizing.
+ *
+ * @param hm        The hashmap
+ * @param count     Number of entries expected
+ */
+void hashmap_reserve(hashmap_t *hm, int count) {
+    int size = roundSize(count);
+    if (size > hm->size) {
+        resize(hm, size);
+    }
+}
+
 bool hashmap_put(hashmap_t *hm, void *key, void *data) {
-    int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            c->data = data;
-            return false;
-        }
-        n = &c->next;
-    }
-    *n = malloc(sizeof(node_t));
-    node_t *mn = *n;
-    mn->hash = hash;
-    mn->key = key;
-    mn->data = data;
-    mn->next = NULL;
+    entry_t *e = findEntry(hm, key);
+    if (e) {
+        e->data = data;
+        return false;
+    }
+    /* Keep the load factor under 7/8, so probe sequences stay short */
+    if (hm->count + 1 > hm->size / 8 * 7) {
+        resize(hm, hm->size * 2);
+    }
+    entry_t entry = {
+        .hash = getHash(hm, key),
+        .key = key,
+        .data = data
+    };
+    insertEntry(hm, entry);
+    hm->count++;
+    migrate(hm, MIGRATE_STEP);
     return true;
 }
 
 void *hashmap_get(hashmap_t *hm, void *key) {
-    int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            return c->data;
-        }
-        n = &c->next;
-    }
-    return NULL;
+    /* Lookups never move entries, so they are safe while iterating */
+    entry_t *e = findEntry(hm, key);
+    return e ? e->data : NULL;
 }
 
 void *hashmap_remove(hashmap_t *hm, void *key) {
-    int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            *n = c->next;
-            void *data = c->data;
-            free(c);
-            return data;
+    uint32_t hash = getHash(hm, key);
+    void *data;
+    int slot = findSlot(hm, key, hash);
+    if (slot != -1) {
+        data = hm->entries[slot].data;
+        /* Shift the following entries back instead of leaving a tombstone */
+        for (int next = nextSlot(hm, slot);
+                hm->entries[next].hash && getDistance(hm, next) != 0;
+                slot = next, next = nextSlot(hm, next)) {
+            hm->entries[slot] = hm->entries[next];
         }
-        n = &c->next;
+        hm->entries[slot].hash = 0;
+    } else {
+        entry_t *e = findOld(hm, key, hash);
+        if (e == NULL) {
+            return NULL;
+        }
+        data = e->data;
+        e->hash = TOMBSTONE;
     }
-    return NULL;
+    hm->count--;
+    /* Shrink when the load factor falls under 1/8 */
+    if (hm->size > MIN_SIZE && hm->count < hm->size / 8) {
+        resize(hm, hm->size / 2);
+    }
+    migrate(hm, MIGRATE_STEP);
+    return data;
 }
 
 void hashmap_dispose(hashmap_t *hm) {
-    int i;
-    for (i = 0; i < hm->size; i++) {
-        node_t *mn = hm->node[i];
-        while (mn != NULL) {
-            node_t *m = mn;
-            mn = m->next;
-            free(m);
+    free_tagged(hm->tag, hm->old);
+    free_tagged(hm->tag, hm->entries);
+    free_tagged(hm->tag, hm);
+}
+
+/* Get the entry at the position, the current table is followed by the old one */
+static inline entry_t *getEntry(hashmap_t *hm, int index) {
+    return index < hm->size ? &hm->entries[index] : &hm->old[index - hm->size];
+}
+
+/**
+ * hashmap_iterInit
+ * Start walking through the entries of a hashmap. The iterator is owned
+ * by the caller and needs no cleanup, so the walk may stop at any point.
+ * Only hashmap_get may be called on the hashmap during the walk: put,
+ * remove and reserve move entries around and between the two tables, so
+ * the walk would skip or repeat entries. Nothing guards against this.
+ *
+ * @param hm        The hashmap
+ * @param it        The iterator to initialize
+ */
+void hashmap_iterInit(hashmap_t *hm, hashmap_iter_t *it) {
+    it->hm = hm;
+    it->index = -1;
+    it->key = NULL;
+    it->value = NULL;
+}
+
+/**
+ * hashmap_iterNext
+ * Move to the next entry, its key and value are stored in the iterator.
+ *
+ * @param it        The iterator
+ * @return          false if there are no more entries
+ */
+bool hashmap_iterNext(hashmap_iter_t *it) {
+    hashmap_t *hm = it->hm;
+    for (it->index++; it->index < hm->size + hm->oldSize; it->index++) {
+        entry_t *e = getEntry(hm, it->index);
+        if (e->hash & 0x80000000) {
+            it->key = e->key;
+            it->value = e->data;
+            return true;
         }
     }
-    free(hm);
+    return false;
 }
 
+/**
+ * hashmap_forEach
+ * Call a function on every entry of a hashmap. The function may look up
+ * the hashmap with hashmap_get, but must not call put, remove or reserve
+ * on it, which may free the table being walked.
+ *
+ * @param hm        The hashmap
+ * @param fn        The function, called with ctx, the key and the value
+ * @param ctx       Passed to the function as is
+ */
+void hashmap_forEach(hashmap_t *hm, void (*fn)(void *ctx, void *key, void *value), void *ctx) {
+    entry_t *tables[] = {hm->entries, hm->old};
+    int sizes[] = {hm->size, hm->oldSize};
+    for (int t = 0; t < 2; t++) {
+        entry_t *e = tables[t];
+        /* The walk is sequential, so prefetching ahead only costs time, see
+         * bench/hashmap.c */
+        for (int i = 0; i < sizes[t]; i++) {
+            if (e[i].hash & 0x80000000) {
+                fn(ctx, e[i].key, e[i].data);
+            }
+        }
+    }
+}
+
+/* Kept for old callers, prefer hashmap_iterInit which does not allocate */
+typedef struct {
+    pair_t kp;
+    hashmap_iter_t it;
+} iterator_t;
+
 pair_t *hashmap_iterator(hashmap_t *hm) {
-    iterator_t *i = malloc(sizeof(iterator_t));
+    iterator_t *i = malloc_tagged(hm->tag, sizeof(iterator_t));
     i->kp.first = NULL;
     i->kp.second = NULL;
-    i->hm = hm;
-    i->index = -1;
-    i->next = NULL;
+    hashmap_iterInit(hm, &i->it);
     return &i->kp;
 }
 
 pair_t *hashmap_next(pair_t *it) {
     iterator_t *i = (iterator_t *)it;
-    if (i->next) {
-        i->kp.first = i->next->key;
-        i->kp.second = i->next->data;
-        i->next = i->next->next;
+    if (hashmap_iterNext(&i->it)) {
+        i->kp.first = i->it.key;
+        i->kp.second = i->it.value;
         return &i->kp;
-    } else {
-        for (i->index++; i->index < i->hm->size; i->index++) {
-            node_t *mn = i->hm->node[i->index];
-            if (mn != NULL) {
-                i->kp.first = mn->key;
-                i->kp.second = mn->data;
-                i->next = mn->next;
-                return &i->kp;
-            }
-        }
-        free(i);
-        return NULL;
     }
+    free_tagged(i->it.hm->tag, i);
+    return NULL;
 }
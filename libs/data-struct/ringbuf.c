@@ -0,0 +1,127 @@
+/**
+ * Provide single-producer single-consumer ring buffer
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include "data-struct/ringbuf.h"
+
+/* Each side reads its own index plainly, and pairs an acquire load of the
+ * other side's index with a release store of its own. So the producer only
+ * publishes items after copying them in, and the consumer only hands a slot
+ * back after copying the item out. */
+
+static inline uint32_t loadAcquire(uint32_t *index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void storeRelease(uint32_t *index, uint32_t value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+/* memcpy may run SIMD kernels whose registers nobody saves, which is not
+ * safe in interrupt handlers or on CPUs that have not enabled them. Items
+ * are usually a few words, so copy them a byte at a time. */
+static inline void copyBytes(char *dest, const char *src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+/* Copy count items between the ring and a flat array, wrapping around */
+static void copyRing(ringbuf_t *rb, uint32_t index, void *items, size_t count, bool in) {
+    size_t slot = index & rb->mask;
+    size_t first = rb->mask + 1 - slot;
+    if (first > count) {
+        first = count;
+    }
+    char *ring = rb->buffer;
+    char *flat = items;
+    if (in) {
+        copyBytes(ring + slot * rb->elemSize, flat, first * rb->elemSize);
+        copyBytes(ring, flat + first * rb->elemSize, (count - first) * rb->elemSize);
+    } else {
+        copyBytes(flat, ring + slot * rb->elemSize, first * rb->elemSize);
+        copyBytes(flat + first * rb->elemSize, ring, (count - first) * rb->elemSize);
+    }
+}
+
+/**
+ * ringbuf_init
+ * Initialize a ring buffer on the given storage.
+ *
+ * @param rb        The ring buffer
+ * @param buffer    Storage of capacity * elemSize bytes
+ * @param capacity  Number of items, must be a power of 2
+ * @param elemSize  Size of each item
+ * @return          false if capacity is not a power of 2
+ */
+bool ringbuf_init(ringbuf_t *rb, void *buffer, size_t capacity, size_t elemSize) {
+    if (capacity == 0 || (capacity & (capacity - 1)) || capacity > 0x80000000) {
+        return false;
+    }
+    rb->head = 0;
+    rb->tail = 0;
+    rb->mask = capacity - 1;
+    rb->elemSize = elemSize;
+    rb->buffer = buffer;
+    return true;
+}
+
+/**
+ * ringbuf_enqueue
+ * Append as many of the items as there is room for, never waits. Must only
+ * be called by the producer.
+ *
+ * @param rb        The ring buffer
+ * @param items     Array of items to append
+ * @param count     Number of items
+ * @return          Number of items appended
+ */
+size_t ringbuf_enqueue(ringbuf_t *rb, const void *items, size_t count) {
+    uint32_t tail = rb->tail;
+    uint32_t room = rb->mask + 1 - (tail - loadAcquire(&rb->head));
+    if (count > room) {
+        count = room;
+    }
+    if (count) {
+        copyRing(rb, tail, (void *)items, count, true);
+        storeRelease(&rb->tail, tail + count);
+    }
+    return count;
+}
+
+/**
+ * ringbuf_dequeue
+ * Take as many items as available up to count, never waits. Must only be
+ * called by the consumer.
+ *
+ * @param rb        The ring buffer
+ * @param items     Array to store the items to
+ * @param count     Maximum number of items
+ * @return          Number of items taken
+ */
+size_t ringbuf_dequeue(ringbuf_t *rb, void *items, size_t count) {
+    uint32_t head = rb->head;
+    uint32_t avail = loadAcquire(&rb->tail) - head;
+    if (count > avail) {
+        count = avail;
+    }
+    if (count) {
+        copyRing(rb, head, items, count, false);
+        storeRelease(&rb->head, head + count);
+    }
+    return count;
+}
+
+/**
+ * ringbuf_count
+ * Get the number of items in the ring buffer. It is exact when called by
+ * either side while the other one is idle, otherwise a snapshot.
+ *
+ * @param rb        The ring buffer
+ * @return          Number of items
+ */
+size_t ringbuf_count(ringbuf_t *rb) {
+    return loadAcquire(&rb->tail) - loadAcquire(&rb->head);
+}
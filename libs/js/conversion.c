@@ -9,6 +9,7 @@
 #include "c/assert.h"
 #include "c/stdint.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/math.h"
 #include "c/inttypes.h"
 
@@ -214,7 +215,7 @@ js_string_t *js_toString(js_data_t *value) {
             size_t len;
             if (K <= N && N <= 21) {
                 len = N + neg;
-                str = malloc(len * sizeof(uint16_t));
+                str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 for (int i = K - 1; i >= 0; i--) {
                     str[neg + i] = '0' + div64(&S, 10);
                 }
@@ -223,7 +224,7 @@ js_string_t *js_toString(js_data_t *value) {
                 }
             } else if (0 < N && N <= 21) {
                 len = K + 1 + neg;
-                str = malloc(len * sizeof(uint16_t));
+                str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 str[neg + N] = '.';
                 for (int i = K - 1; i >= N; i--) {
                     str[neg + i + 1] = '0' + div64(&S, 10);
@@ -233,7 +234,7 @@ js_string_t *js_toString(js_data_t *value) {
                 }
             } else if (-6 < N && N <= 0) {
                 len = N + K + 2 + neg;
-                str = malloc(len * sizeof(uint16_t));
+                str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 str[neg] = '0';
                 str[neg + 1] = '.';
                 for (int i = 0; i < N; i++) {
@@ -247,7 +248,7 @@ js_string_t *js_toString(js_data_t *value) {
                 N = nNeg ? -N + 1 : N - 1;
                 int expLen = countLen(N);
                 len = expLen + neg + 3;
-                str = malloc(len * sizeof(uint16_t));
+                str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 str[neg] = '0' + (uint16_t)S;
                 str[neg + 1] = 'e';
                 str[neg + 2] = nNeg ? '-' : '+';
@@ -260,7 +261,7 @@ js_string_t *js_toString(js_data_t *value) {
                 N = nNeg ? -N + 1 : N - 1;
                 int expLen = countLen(N);
                 len = expLen + neg + K + 3;
-                str = malloc(len * sizeof(uint16_t));
+                str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 str[neg + 1] = '.';
                 for (int i = K - 1; i >= 1; i--) {
                     str[neg + i + 1] = '0' + div64(&S, 10);
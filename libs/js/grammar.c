@@ -1,5 +1,6 @@
 #include "js/js.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "unicode/hash.h"
 #include "c/assert.h"
 
@@ -7,6 +8,8 @@ typedef struct struct_grammar grammar_t;
 
 struct struct_grammar {
     lex_t *lex;
+    /* Nodes are allocated from the arena, or the heap if NULL */
+    arena_t *arena;
     js_token_t *next;
     size_t listLen;
     bool noIn;
@@ -85,9 +88,11 @@ static bool expectSemicolon(grammar_t *gmr) {
     }
 }
 
-grammar_t *grammar_new(lex_t *lex) {
-    grammar_t *gmr = malloc(sizeof(struct struct_grammar));
+grammar_t *grammar_new(lex_t *lex, arena_t *arena) {
+    grammar_t *gmr = arena ? arena_alloc(arena, sizeof(struct struct_grammar)) : malloc_tagged(MALLOC_TAG_JS, sizeof(struct struct_grammar));
+    assert(gmr);
     gmr->lex = lex;
+    gmr->arena = arena;
     gmr->next = NULL;
     gmr->listLen = 0;
     gmr->noIn = true;
@@ -107,7 +112,7 @@ static js_data_t *grammar_primaryExpr(grammar_t *gmr) {
     switch (lookahead(gmr)->type) {
         case THIS:
             next(gmr);
-            return (js_data_t *)js_allocEmptyNode(THIS_NODE);
+            return (js_data_t *)js_allocEmptyNode(gmr->arena, THIS_NODE);
         case ID: assert(0); /*{
             js_token_t *id = next(gmr);
             primary_expr_id_node_t *node = (primary_expr_id_node_t *)createNode(PRIMARY_EXPR_ID_NODE, sizeof(literal_node_t));
@@ -202,7 +207,7 @@ static js_data_t *grammar_memberExpr(grammar_t *gmr) {
                 gmr->lex->parseId = false;
                 js_token_t *id = expect(gmr, ID);
                 gmr->lex->parseId = true;
-                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(MEMBER_NODE);
+                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(gmr->arena, MEMBER_NODE);
                 node->_1 = cur;
                 node->_2 = id->value;
                 cur = (js_data_t *)node;
@@ -212,7 +217,7 @@ static js_data_t *grammar_memberExpr(grammar_t *gmr) {
                 next(gmr);
                 js_data_t *expr = grammar_expr(gmr);
                 expect(gmr, R_BRACKET);
-                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(MEMBER_NODE);
+                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(gmr->arena, MEMBER_NODE);
                 node->_1 = cur;
                 node->_2 = expr;
                 cur = (js_data_t *)node;
@@ -267,7 +272,7 @@ static js_data_t *grammar_leftHandSideExpr(grammar_t *gmr) {
                 gmr->lex->parseId = false;
                 js_token_t *id = expect(gmr, ID);
                 gmr->lex->parseId = true;
-                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(MEMBER_NODE);
+                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(gmr->arena, MEMBER_NODE);
                 node->_1 = cur;
                 node->_2 = id->value;
                 cur = (js_data_t *)node;
@@ -277,7 +282,7 @@ static js_data_t *grammar_leftHandSideExpr(grammar_t *gmr) {
                 next(gmr);
                 js_data_t *expr = grammar_expr(gmr);
                 expect(gmr, R_BRACKET);
-                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(MEMBER_NODE);
+                js_binary_node_t *node = (js_binary_node_t *)js_allocBinaryNode(gmr->arena, MEMBER_NODE);
                 node->_1 = cur;
                 node->_2 = expr;
                 cur = (js_data_t *)node;
@@ -309,12 +314,12 @@ static js_data_t *grammar_postfixExpr(grammar_t *gmr) {
 
     if (nxt->type == INC) {
         next(gmr);
-        js_unary_node_t *node = js_allocUnaryNode(POST_INC_NODE);
+        js_unary_node_t *node = js_allocUnaryNode(gmr->arena, POST_INC_NODE);
         node->_1 = expr;
         return (js_data_t *)node;
     } else if (nxt->type == DEC) {
         next(gmr);
-        js_unary_node_t *node = js_allocUnaryNode(POST_DEC_NODE);
+        js_unary_node_t *node = js_allocUnaryNode(gmr->arena, POST_DEC_NODE);
         node->_1 = expr;
         return (js_data_t *)node;
     }
@@ -356,7 +361,7 @@ static js_data_t *grammar_unaryExpr(grammar_t *gmr) {
             nodeClass = LNOT_NODE;
 produceExpr:
             next(gmr);
-            js_unary_node_t *node = js_allocUnaryNode(nodeClass);
+            js_unary_node_t *node = js_allocUnaryNode(gmr->arena, nodeClass);
             node->_1 = grammar_unaryExpr(gmr);
             return (js_data_t *)node;
         default:
@@ -379,7 +384,7 @@ produceExpr:
     return cur;\
     }\
     next(gmr);\
-    js_binary_node_t *node = js_allocBinaryNode(type);\
+    js_binary_node_t *node = js_allocBinaryNode(gmr->arena, type);\
     node->_1 = cur;\
     node->_2 = grammar_##_previous(gmr);\
     cur = (js_data_t *)node;\
@@ -443,7 +448,7 @@ static js_data_t *grammar_condExpr(grammar_t *gmr) {
         js_data_t *t_exp = grammar_assignExpr(gmr);
         expect(gmr, COLON);
         js_data_t *f_exp = grammar_assignExpr(gmr);
-        js_ternary_node_t *ret = js_allocTernaryNode(COND_NODE);
+        js_ternary_node_t *ret = js_allocTernaryNode(gmr->arena, COND_NODE);
         ret->_1 = node;
         ret->_2 = t_exp;
         ret->_3 = f_exp;
@@ -473,7 +478,7 @@ static js_data_t *grammar_assignExpr(grammar_t *gmr) {
         default: return node;
     }
     next(gmr);
-    js_binary_node_t *ass = js_allocBinaryNode(type);
+    js_binary_node_t *ass = js_allocBinaryNode(gmr->arena, type);
     ass->_1 = node;
     ass->_2 = grammar_assignExpr(gmr);
     return (js_data_t *)ass;
@@ -517,7 +522,7 @@ node_t *grammar_stmt(grammar_t *gmr) {
 js_data_t *grammar_exprStmt(grammar_t *gmr) {
     js_data_t *expr = grammar_expr(gmr);
 
-    js_unary_node_t *node = js_allocUnaryNode(EXPR_STMT);
+    js_unary_node_t *node = js_allocUnaryNode(gmr->arena, EXPR_STMT);
     node->_1 = expr;
 
     expectSemicolon(gmr);
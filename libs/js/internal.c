@@ -3,6 +3,7 @@
 #include "c/assert.h"
 #include "c/stdint.h"
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/math.h"
 #include "c/inttypes.h"
 
@@ -235,7 +236,7 @@ static js_data_t *doBinaryOp(enum js_binary_node_type_t type, js_data_t *lval, j
                 js_string_t *lstr = js_toString(lprim);
                 js_string_t *rstr = js_toString(rprim);
                 size_t len = lstr->value.len + rstr->value.len;
-                uint16_t *str = malloc(len * sizeof(uint16_t));
+                uint16_t *str = malloc_tagged(MALLOC_TAG_JS, len * sizeof(uint16_t));
                 memcpy(str, lstr->value.str, lstr->value.len * sizeof(uint16_t));
                 memcpy(str + lstr->value.len, rstr->value.str, rstr->value.len * sizeof(uint16_t));
                 return (js_data_t *)js_new_string((utf16_string_t) {
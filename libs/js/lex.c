@@ -1,8 +1,10 @@
 #include "js/js.h"
 #include "unicode/type.h"
 #include "unicode/hash.h"
+#include "data-struct/typedmap.h"
 
 #include "c/stdlib.h"
+#include "c-stdlib/malloc.h"
 #include "c/stdio.h"
 #include "c/assert.h"
 #include "c/stdbool.h"
@@ -24,10 +26,11 @@ enum {
     ZWJ = 0x200D
 };
 
-static hashmap_t *keywords = NULL;
+DEFINE_HASHMAP(keywordMap, utf16_string_t, uint16_t, unicode_utf16KeyHash, unicode_utf16KeyEquals)
+
+static keywordMap_t keywords = { .tag = MALLOC_TAG_JS };
 
 static void initKeyword(void) {
-    keywords = hashmap_new_utf16(97);
     static struct {
         char *name;
         uint16_t value;
@@ -82,17 +85,16 @@ static void initKeyword(void) {
         {"false", FALSE_LIT}
     };
     for (int i = 0; i < sizeof(map) / sizeof(map[0]); i++) {
-        utf16_string_t *utf16 = malloc(sizeof(utf16_string_t));
-        *utf16 = unicode_toUtf16(UTF8_STRING(map[i].name));
-        hashmap_put(keywords, utf16, (void *)(size_t)map[i].value);
+        keywordMap_put(&keywords, unicode_toUtf16(UTF8_STRING(map[i].name)), map[i].value);
     }
 }
 
 static uint16_t lookupKeyword(utf16_string_t kwd) {
-    if (!keywords) {
+    if (!keywords.count) {
         initKeyword();
     }
-    return (size_t)hashmap_get(keywords, &kwd);
+    uint16_t *value = keywordMap_get(&keywords, kwd);
+    return value ? *value : 0;
 }
 
 static uint16_t lookahead(lex_t *lex) {
@@ -110,23 +112,19 @@ static uint16_t next(lex_t *lex) {
 }
 
 static void createBuffer(lex_t *lex) {
-    lex->data.length = 0;
-    lex->data.size = 10;
-    lex->data.buffer = malloc(10 * sizeof(uint16_t));
+    js_charbuf_init(&lex->data.buffer, MALLOC_TAG_JS);
 }
 
 static void appendToBuffer(lex_t *lex, uint16_t ch) {
-    if (lex->data.length == lex->data.size) {
-        lex->data.size *= (lex->data.size * 3) / 2 + 1;
-        lex->data.buffer = realloc(lex->data.buffer, lex->data.size * sizeof(uint16_t));
-    }
-    lex->data.buffer[lex->data.length++] = ch;
+    js_charbuf_push(&lex->data.buffer, ch);
 }
 
+/* The buffer becomes the string, so give back the room left for growing */
 static utf16_string_t cleanBuffer(lex_t *lex) {
+    js_charbuf_shrink(&lex->data.buffer);
     utf16_string_t ret = {
-        .str = lex->data.buffer,
-        .len = lex->data.length
+        .str = lex->data.buffer.data,
+        .len = lex->data.buffer.length
     };
     return ret;
 }
@@ -175,9 +173,9 @@ static js_token_t *stateDefault(lex_t *lex) {
                 } else {
                     if (lex->lookahead(lex) == '=') {
                         lex->next(lex);
-                        return js_allocToken(DIV_ASSIGN);
+                        return js_allocToken(lex->arena, DIV_ASSIGN);
                     } else {
-                        return js_allocToken(DIV);
+                        return js_allocToken(lex->arena, DIV);
                     }
                 }
             }
@@ -205,49 +203,49 @@ static js_token_t *stateDefault(lex_t *lex) {
         case '~':
         case '?':
         case ':': {
-            return js_allocToken(next);
+            return js_allocToken(lex->arena, next);
         }
         case '<': {
             uint16_t nch = lex->lookahead(lex);
             if (nch == '=') {
                 lex->next(lex);
-                return js_allocToken(LTEQ);
+                return js_allocToken(lex->arena, LTEQ);
             } else if (nch == '<') {
                 lex->next(lex);
                 if (lex->lookahead(lex) == '=') {
                     lex->next(lex);
-                    return js_allocToken(SHL_ASSIGN);
+                    return js_allocToken(lex->arena, SHL_ASSIGN);
                 } else {
-                    return js_allocToken(SHL);
+                    return js_allocToken(lex->arena, SHL);
                 }
             } else {
-                return js_allocToken(LT);
+                return js_allocToken(lex->arena, LT);
             }
         }
         case '>': {
             uint16_t nch = lex->lookahead(lex);
             if (nch == '=') {
                 lex->next(lex);
-                return js_allocToken(GTEQ);
+                return js_allocToken(lex->arena, GTEQ);
             } else if (nch == '>') {
                 lex->next(lex);
                 uint16_t n2ch = lex->lookahead(lex);
                 if (n2ch == '=') {
                     lex->next(lex);
-                    return js_allocToken(SHR_ASSIGN);
+                    return js_allocToken(lex->arena, SHR_ASSIGN);
                 } else if (n2ch == '>') {
                     lex->next(lex);
                     if (lex->lookahead(lex) == '=') {
                         lex->next(lex);
-                        return js_allocToken(USHR_ASSIGN);
+                        return js_allocToken(lex->arena, USHR_ASSIGN);
                     } else {
-                        return js_allocToken(USHR);
+                        return js_allocToken(lex->arena, USHR);
                     }
                 } else {
-                    return js_allocToken(SHR);
+                    return js_allocToken(lex->arena, SHR);
                 }
             } else {
-                return js_allocToken(GT);
+                return js_allocToken(lex->arena, GT);
             }
         }
         case '=':
@@ -256,12 +254,12 @@ static js_token_t *stateDefault(lex_t *lex) {
                 lex->next(lex);
                 if (lex->lookahead(lex) == '=') {
                     lex->next(lex);
-                    return js_allocToken(next == '=' ? FULL_EQ : FULL_INEQ);
+                    return js_allocToken(lex->arena, next == '=' ? FULL_EQ : FULL_INEQ);
                 } else {
-                    return js_allocToken(next | ASSIGN_FLAG);
+                    return js_allocToken(lex->arena, next | ASSIGN_FLAG);
                 }
             } else {
-                return js_allocToken(next);
+                return js_allocToken(lex->arena, next);
             }
         }
         case '+':
@@ -271,12 +269,12 @@ static js_token_t *stateDefault(lex_t *lex) {
             uint16_t nch = lex->lookahead(lex);
             if (nch == '=') {
                 lex->next(lex);
-                return js_allocToken(next | ASSIGN_FLAG);
+                return js_allocToken(lex->arena, next | ASSIGN_FLAG);
             } else if (nch == next) {
                 lex->next(lex);
-                return js_allocToken(next | DOUBLE_FLAG);
+                return js_allocToken(lex->arena, next | DOUBLE_FLAG);
             } else {
-                return js_allocToken(next);
+                return js_allocToken(lex->arena, next);
             }
         }
         case '*':
@@ -284,9 +282,9 @@ static js_token_t *stateDefault(lex_t *lex) {
         case '^': {
             if (lex->lookahead(lex) == '=') {
                 lex->next(lex);
-                return js_allocToken(next | ASSIGN_FLAG);
+                return js_allocToken(lex->arena, next | ASSIGN_FLAG);
             } else {
-                return js_allocToken(next);
+                return js_allocToken(lex->arena, next);
             }
         }
         case '0': {
@@ -329,7 +327,7 @@ static js_token_t *stateDefault(lex_t *lex) {
         }
         case 0xFFFF: {
             lex->lineBefore = true;
-            return js_allocToken(END_OF_FILE);
+            return js_allocToken(lex->arena, END_OF_FILE);
         }
     }
 
@@ -424,7 +422,7 @@ static js_token_t *stateIdentiferPart(lex_t *lex) {
     utf16_string_t str = cleanBuffer(lex);
 
     if (!lex->parseId) {
-        js_token_t *token = js_allocToken(ID);
+        js_token_t *token = js_allocToken(lex->arena, ID);
         token->value = (js_data_t *)js_new_string(str);
         return token;
     }
@@ -439,15 +437,15 @@ static js_token_t *stateIdentiferPart(lex_t *lex) {
         }
     }
     if (!type) {
-        js_token_t *token = js_allocToken(ID);
+        js_token_t *token = js_allocToken(lex->arena, ID);
         token->value = (js_data_t *)js_new_string(str);
         return token;
     } else if (type == RESERVED_WORD) {
         assert(!"SyntaxError: Unexpected reserved word.");
         return NULL;
     } else {
-        free(str.str);
-        return js_allocToken(type);
+        free_tagged(MALLOC_TAG_JS, str.str);
+        return js_allocToken(lex->arena, type);
     }
 }
 
@@ -472,7 +470,7 @@ static js_token_t *stateOctIntegerLiteral(lex_t *lex) {
 
         lex->state = stateDefault;
 
-        js_token_t *token = js_allocToken(NUM);
+        js_token_t *token = js_allocToken(lex->arena, NUM);
         token->value = js_new_number(lex->data.number);
 
         return token;
@@ -507,7 +505,7 @@ static js_token_t *stateHexIntegerLiteral(lex_t *lex) {
 
         lex->state = stateDefault;
 
-        js_token_t *token = js_allocToken(NUM);
+        js_token_t *token = js_allocToken(lex->arena, NUM);
         token->value = js_new_number(lex->data.number);
 
         return token;
@@ -539,7 +537,7 @@ static js_token_t *stateDoubleString(lex_t *lex) {
         case '"': {
             lex->state = stateDefault;
 
-            js_token_t *token = js_allocToken(STR);
+            js_token_t *token = js_allocToken(lex->arena, STR);
             token->value = (js_data_t *)js_new_string(cleanBuffer(lex));
 
             return token;
@@ -567,7 +565,7 @@ static js_token_t *stateSingleString(lex_t *lex) {
         case '\'': {
             lex->state = stateDefault;
 
-            js_token_t *token = js_allocToken(STR);
+            js_token_t *token = js_allocToken(lex->arena, STR);
             token->value = (js_data_t *)js_new_string(cleanBuffer(lex));
 
             return token;
@@ -589,8 +587,9 @@ static js_token_t *stateSingleString(lex_t *lex) {
     }
 }
 
-lex_t *lex_new(char *chr) {
-    lex_t *l = malloc(sizeof(struct struct_lex));
+lex_t *lex_new(char *chr, arena_t *arena) {
+    lex_t *l = arena ? arena_alloc(arena, sizeof(struct struct_lex)) : malloc_tagged(MALLOC_TAG_JS, sizeof(struct struct_lex));
+    assert(l);
     l->next = next;
     l->lookahead = lookahead;
     l->state = stateDefault;
@@ -600,6 +599,7 @@ lex_t *lex_new(char *chr) {
     l->strictMode = true;
     l->lineBefore = false;
     l->parseId = true;
+    l->arena = arena;
     return l;
 }
 
@@ -11,17 +11,9 @@
 
 #include "data-struct/hashmap.h"
 
-static int hash_js_string(void *str) {
-    return unicode_utf16Hash(&((js_string_t *)str)->value);
-}
-
-static int compare_js_string(void *x, void *y) {
-    return unicode_utf16Cmp(&((js_string_t *)x)->value, &((js_string_t *)y)->value);
-}
-
 static js_property_t *getOwnProperty(js_object_t *O, js_string_t *P) {
-    js_property_t *desc = hashmap_get(O->properties, P);
-    return desc;
+    js_property_t **desc = js_propmap_get(&O->properties, P);
+    return desc ? *desc : NULL;
 }
 
 static js_property_t *getProperty(js_object_t *O, js_string_t *P) {
@@ -135,7 +127,7 @@ static bool _delete(js_object_t *O, js_string_t *P, bool throw) {
         return true;
     }
     if (js_isTrue(desc->configurable)) {
-        hashmap_remove(O->properties, P);
+        js_propmap_remove(&O->properties, P, NULL);
         return true;
     } else {
         if (throw) {
@@ -165,13 +157,17 @@ static bool defineOwnProperty(js_object_t *O, js_string_t *P, js_property_t *des
             if (!desc->writable)desc->writable = js_constFalse;
             if (!desc->enumerable)desc->enumerable = js_constFalse;
             if (!desc->configurable)desc->configurable = js_constFalse;
-            hashmap_put(O->properties, P, desc);
+            if (js_propmap_put(&O->properties, P, desc) == TYPEDMAP_NOMEM) {
+                return false;
+            }
         } else {
             if (!desc->get)desc->get = js_constUndefined;
             if (!desc->set)desc->set = js_constUndefined;
             if (!desc->enumerable)desc->enumerable = js_constFalse;
             if (!desc->configurable)desc->configurable = js_constFalse;
-            hashmap_put(O->properties, P, desc);
+            if (js_propmap_put(&O->properties, P, desc) == TYPEDMAP_NOMEM) {
+                return false;
+            }
         }
         return true;
     }
@@ -241,7 +237,7 @@ static bool defineOwnProperty(js_object_t *O, js_string_t *P, js_property_t *des
 
 js_object_t *js_allocObject(void) {
     js_object_t *obj = (js_object_t *)js_alloc(JS_OBJECT);
-    obj->properties = hashmap_new(hash_js_string, compare_js_string, 11);
+    js_propmap_init(&obj->properties, MALLOC_TAG_JS);
     obj->prototype = NULL;
     obj->clazz = NULL;
     obj->extensible = true;
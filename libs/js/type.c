@@ -5,6 +5,8 @@
 #include "c/stdlib.h"
 #include "c/assert.h"
 
+#include "c-stdlib/malloc.h"
+
 #include "unicode/convert.h"
 
 js_data_t *js_constNull = NULL;
@@ -23,7 +25,27 @@ js_string_t *js_constInfStr = NULL;
 js_string_t *js_constNegInfStr = NULL;
 js_string_t *js_constZeroStr = NULL;
 
-js_data_t *js_alloc(enum js_data_type_t type) {
+/* Each type has its own object cache, created on first use */
+static objcache_t *caches[JS_INTERNAL_TERNARY_NODE + 1];
+
+static const char *cacheNames[JS_INTERNAL_TERNARY_NODE + 1] = {
+    [JS_NULL] = "js_null",
+    [JS_UNDEFINED] = "js_undefined",
+    [JS_BOOLEAN] = "js_boolean",
+    [JS_STRING] = "js_string",
+    [JS_NUMBER] = "js_number",
+    [JS_OBJECT] = "js_object",
+    [JS_INTERNAL_REF] = "js_reference",
+    [JS_INTERNAL_COMPLETION] = "js_completion",
+    [JS_INTERNAL_PROPERTY] = "js_property",
+    [JS_INTERNAL_TOKEN] = "js_token",
+    [JS_INTERNAL_EMPTY_NODE] = "js_empty_node",
+    [JS_INTERNAL_UNARY_NODE] = "js_unary_node",
+    [JS_INTERNAL_BINARY_NODE] = "js_binary_node",
+    [JS_INTERNAL_TERNARY_NODE] = "js_ternary_node"
+};
+
+static js_data_t *allocData(arena_t *arena, enum js_data_type_t type) {
     size_t size;
     switch (type) {
         case JS_NULL:
@@ -67,12 +89,25 @@ js_data_t *js_alloc(enum js_data_type_t type) {
         default:
             assert(0);
     }
-    js_data_t *data = malloc(size);
+    js_data_t *data;
+    if (arena) {
+        data = arena_alloc(arena, size);
+    } else {
+        if (caches[type] == NULL) {
+            caches[type] = objcache_new(MALLOC_TAG_JS, cacheNames[type], size, sizeof(double), NULL);
+        }
+        data = objcache_alloc(caches[type]);
+    }
+    assert(data);
     data->type = type;
     data->flag = 0;
     return data;
 }
 
+js_data_t *js_alloc(enum js_data_type_t type) {
+    return allocData(NULL, type);
+}
+
 js_completion_t *js_allocCompletion(enum js_completion_type_t type) {
     js_completion_t *comp = (js_completion_t *)js_alloc(JS_INTERNAL_COMPLETION);
     comp->type = type;
@@ -81,8 +116,8 @@ js_completion_t *js_allocCompletion(enum js_completion_type_t type) {
     return comp;
 }
 
-js_token_t *js_allocToken(enum js_token_type_t type) {
-    js_token_t *token = (js_token_t *)js_alloc(JS_INTERNAL_TOKEN);
+js_token_t *js_allocToken(arena_t *arena, enum js_token_type_t type) {
+    js_token_t *token = (js_token_t *)allocData(arena, JS_INTERNAL_TOKEN);
     token->type = type;
     token->next = NULL;
     token->value = NULL;
@@ -90,26 +125,26 @@ js_token_t *js_allocToken(enum js_token_type_t type) {
     return token;
 }
 
-js_empty_node_t *js_allocEmptyNode(enum js_empty_node_type_t type) {
-    js_empty_node_t *node = (js_empty_node_t *)js_alloc(JS_INTERNAL_EMPTY_NODE);
+js_empty_node_t *js_allocEmptyNode(arena_t *arena, enum js_empty_node_type_t type) {
+    js_empty_node_t *node = (js_empty_node_t *)allocData(arena, JS_INTERNAL_EMPTY_NODE);
     node->type = type;
     return node;
 }
 
-js_unary_node_t *js_allocUnaryNode(enum js_unary_node_type_t type) {
-    js_unary_node_t *node = (js_unary_node_t *)js_alloc(JS_INTERNAL_UNARY_NODE);
+js_unary_node_t *js_allocUnaryNode(arena_t *arena, enum js_unary_node_type_t type) {
+    js_unary_node_t *node = (js_unary_node_t *)allocData(arena, JS_INTERNAL_UNARY_NODE);
     node->type = type;
     return node;
 }
 
-js_binary_node_t *js_allocBinaryNode(enum js_binary_node_type_t type) {
-    js_binary_node_t *node = (js_binary_node_t *)js_alloc(JS_INTERNAL_BINARY_NODE);
+js_binary_node_t *js_allocBinaryNode(arena_t *arena, enum js_binary_node_type_t type) {
+    js_binary_node_t *node = (js_binary_node_t *)allocData(arena, JS_INTERNAL_BINARY_NODE);
     node->type = type;
     return node;
 }
 
-js_ternary_node_t *js_allocTernaryNode(enum js_ternary_node_type_t type) {
-    js_ternary_node_t *node = (js_ternary_node_t *)js_alloc(JS_INTERNAL_TERNARY_NODE);
+js_ternary_node_t *js_allocTernaryNode(arena_t *arena, enum js_ternary_node_type_t type) {
+    js_ternary_node_t *node = (js_ternary_node_t *)allocData(arena, JS_INTERNAL_TERNARY_NODE);
     node->type = type;
     return node;
 }
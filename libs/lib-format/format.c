@@ -18,75 +18,275 @@
 #define SIGN 32
 #define SMALL 64
 
-/* Important: these function maybe moved and changed, the declaration are not safe */
-static char *itoa(int32_t num, char *str, int32_t radix, int32_t width, int32_t precision, int32_t type);
-static int32_t atoi(char *p);
-
-static char *itoa(int32_t num, char *str, int32_t radix, int32_t width, int32_t precision, int32_t type) {
-    const char *index = (type & SMALL) ? "0123456789abcdefghijklmnopqrstuvwxyz" : "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    size_t unum;
-    int32_t i = 0, j, k;
-    if ((type & (SIGN | PLUS)) && num < 0) {
-        unum = (size_t) - num;
-        str[i++] = '-';
-    } else if (type & PLUS) {
-        unum = (size_t)num;
-        str[i++] = '+';
-    } else
-        unum = (size_t)num;
-    if (type & SPECIAL) {
-        if (radix == 8)str[i++] = '0';
-        else if (radix == 16) {
-            str[i++] = '0';
-            str[i++] = (type & SMALL) ? 'x' : 'X';
+enum {
+    /* Output for a sink is gathered here and sent in chunks of this size */
+    STAGE_SIZE = 64
+};
+
+/* Output of a single formatting call. Characters are written to pos, up to
+ * limit. With a sink, the window is stage and it is sent to the sink each
+ * time it fills up. With a buffer, the window is the buffer, and once that
+ * is full it becomes stage and what is written there is dropped, so the rest
+ * is only counted. Either way most output is a store and an increment. */
+typedef struct {
+    printf_sink_t *sink;
+    char *pos;
+    char *limit;
+    /* Start of the window, and how many characters came before it */
+    char *base;
+    size_t count;
+    char stage[STAGE_SIZE];
+} output_t;
+
+/* Pass the window on to the sink, or drop it, and start over in stage */
+static void flush(output_t *out) {
+    size_t len = out->pos - out->base;
+    if (out->sink && len) {
+        out->sink->write(out->sink, out->base, len);
+    }
+    out->count += len;
+    out->base = out->pos = out->stage;
+    out->limit = out->stage + STAGE_SIZE;
+}
+
+/* Write what does not fit in the window, flushing as it fills up */
+static void emitSlow(output_t *out, const char *str, size_t len) {
+    size_t room = out->limit - out->pos;
+    memcpy(out->pos, str, room);
+    out->pos += room;
+    str += room;
+    len -= room;
+    flush(out);
+    if (len >= STAGE_SIZE && out->sink) {
+        /* Too long to be worth gathering */
+        out->sink->write(out->sink, str, len);
+        out->count += len;
+        return;
+    }
+    while (len > STAGE_SIZE) {
+        /* Only reached without a sink, where the stage is dropped */
+        out->pos = out->limit;
+        str += STAGE_SIZE;
+        len -= STAGE_SIZE;
+        flush(out);
+    }
+    memcpy(out->pos, str, len);
+    out->pos += len;
+}
+
+static inline void emit(output_t *out, const char *str, size_t len) {
+    char *pos = out->pos;
+    if (len > (size_t)(out->limit - pos)) {
+        emitSlow(out, str, len);
+        return;
+    }
+    /* Most chunks are a few characters, too short to be worth a call */
+    if (len <= 16) {
+        for (size_t i = 0; i < len; i++) {
+            pos[i] = str[i];
         }
+    } else {
+        memcpy(pos, str, len);
     }
-    do {
-        str[i++] = index[unum % (unsigned)radix];
-        unum /= radix;
-    } while (unum);
-    if (str[0] == '-' || str[0] == '+')
-        k = 1;
-    else k = 0;
-    k += (type & SPECIAL) ? (radix == 8 ? 1 : (radix == 16 ? 2 : 0)) : 0;
-    char temp;
-    if (!(type & LEFT))
-        while (i < width) {
-            str[i++] = (type & ZEROPAD) ? '0' : ' ';
+    out->pos = pos + len;
+}
+
+/* Copy str up to its terminator or the stop character, scanning and
+ * copying in one pass. Returns where the copy stopped. */
+static inline const char *emitUntil(output_t *out, const char *str, char stop) {
+    while (1) {
+        char *pos = out->pos;
+        size_t room = out->limit - pos;
+        for (size_t i = 0; i < room; i++) {
+            char c = str[i];
+            if (c == 0 || c == stop) {
+                out->pos = pos + i;
+                return str + i;
+            }
+            pos[i] = c;
         }
-    for (j = k; j <= (i + k - 1) / 2; j++) {
-        temp = str[j];
-        str[j] = str[i - 1 + k - j];
-        str[i - j - 1 + k] = temp;
+        out->pos = pos + room;
+        str += room;
+        flush(out);
     }
-    while (i < width) {
-        str[i++] = ' ';
+}
+
+/* Number of characters produced so far */
+static size_t outputCount(output_t *out) {
+    return out->count + (out->pos - out->base);
+}
+
+/* Send count copies of the character, a chunk at a time */
+static void padChunks(output_t *out, char c, int count) {
+    static const char spaces[] = "                ";
+    static const char zeros[] = "0000000000000000";
+    const char *chunk = c == '0' ? zeros : spaces;
+    while (count > 0) {
+        int len = count < (int)sizeof(spaces) - 1 ? count : (int)sizeof(spaces) - 1;
+        emit(out, chunk, len);
+        count -= len;
     }
-    return str + i;
 }
 
-__attribute__((unused))
-static int32_t atoi(char *p) {
-    bool neg = false;
-    int32_t res = 0;
-    if (p[0] == '+' || p[0] == '-')
-        neg = (*p++ != '+');
-    while (*p >= '0' && *p <= '9')
-        res = res * 10 + (*p++ -'0');
-    return neg ? -res : res;
+/* Most fields have no padding, so skip the call for them */
+static inline void pad(output_t *out, char c, int count) {
+    if (count > 0) {
+        padChunks(out, c, count);
+    }
 }
 
-int vsprintf(char *buf, const char *fmt, va_list args) {
-    char *p;
-    char tmp[256];
+/* Decimal digits of 0 to 99, two characters each */
+static const char digitPairs[200] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Write the decimal digits of num backwards ending at p, two per division */
+static char *formatDecimal32(char *p, uint32_t num) {
+    while (num >= 100) {
+        const char *pair = digitPairs + num % 100 * 2;
+        num /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (num >= 10) {
+        *--p = digitPairs[num * 2 + 1];
+        *--p = digitPairs[num * 2];
+    } else {
+        *--p = '0' + num;
+    }
+    return p;
+}
+
+/* Divide num in place by a 32-bit divisor and return the remainder. The
+ * libgcc helper for 64-bit division is not linked, so do two steps of long
+ * division which each only divide 64 bits by 32 bits. */
+static uint32_t divide64(uint64_t *num, uint32_t divisor) {
+    uint32_t high = *num >> 32;
+    uint32_t low = *num;
+    uint32_t quotHigh = high / divisor;
+    uint32_t quotLow, rem = high % divisor;
+#ifdef __i386__
+    /* rem < divisor, so the quotient fits and divl cannot fault */
+    __asm__("divl %4":"=a"(quotLow), "=d"(rem):"a"(low), "d"(rem), "rm"(divisor));
+#else
+    uint64_t part = (uint64_t)rem << 32 | low;
+    quotLow = part / divisor;
+    rem = part % divisor;
+#endif
+    *num = (uint64_t)quotHigh << 32 | quotLow;
+    return rem;
+}
 
-    for (p = buf; *fmt != 0; fmt++) {
+static char *formatDecimal(char *p, uint64_t num) {
+    /* Peel off 8 digits at a time until the rest fits in 32 bits */
+    while (num >> 32) {
+        char *end = p;
+        p = formatDecimal32(p, divide64(&num, 100000000));
+        while (p > end - 8) {
+            *--p = '0';
+        }
+    }
+    return formatDecimal32(p, num);
+}
+
+/* Radix 8 or 16 only need shifts and masks */
+static char *formatPower2(char *p, uint64_t num, int shift, const char *index) {
+    uint32_t mask = (1 << shift) - 1;
+    do {
+        *--p = index[num & mask];
+        num >>= shift;
+    } while (num);
+    return p;
+}
+
+static void formatNumber(output_t *out, uint64_t num, bool negative, int radix, int width, int precision, int flags) {
+    /* Digits are written backwards from the end, then zeros and prefix in
+     * front of them if they fit */
+    char buf[64];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    /* Precision 0 prints nothing for a zero */
+    if (num || precision != 0) {
+        if (radix == 10) {
+            p = formatDecimal(p, num);
+        } else {
+            const char *index = (flags & SMALL) ? "0123456789abcdef" : "0123456789ABCDEF";
+            p = formatPower2(p, num, radix == 16 ? 4 : 3, index);
+        }
+    }
+    int len = end - p;
+
+    char prefix[3];
+    int prefixLen = 0;
+    if (negative) {
+        prefix[prefixLen++] = '-';
+    } else if (flags & PLUS) {
+        prefix[prefixLen++] = '+';
+    } else if (flags & SPACE) {
+        prefix[prefixLen++] = ' ';
+    }
+    if (flags & SPECIAL) {
+        if (radix == 8 && (len == 0 || *p != '0') && precision <= len) {
+            prefix[prefixLen++] = '0';
+        } else if (radix == 16 && len && *p != '0') {
+            prefix[prefixLen++] = '0';
+            prefix[prefixLen++] = (flags & SMALL) ? 'x' : 'X';
+        }
+    }
+
+    int zeros = precision > len ? precision - len : 0;
+    if (precision < 0 && (flags & (ZEROPAD | LEFT)) == ZEROPAD) {
+        zeros = width - prefixLen - len;
+    }
+    if (zeros < 0) {
+        zeros = 0;
+    }
+    int spaces = width - prefixLen - zeros - len;
+    if (!(flags & LEFT)) {
+        pad(out, ' ', spaces);
+    }
+    if (zeros + prefixLen <= p - buf) {
+        /* Common case, the whole number is sent to the sink at once */
+        for (; zeros; zeros--) {
+            *--p = '0';
+        }
+        while (prefixLen) {
+            *--p = prefix[--prefixLen];
+        }
+        emit(out, p, end - p);
+    } else {
+        emit(out, prefix, prefixLen);
+        pad(out, '0', zeros);
+        emit(out, p, len);
+    }
+    if (flags & LEFT) {
+        pad(out, ' ', spaces);
+    }
+}
+
+/* Send a string as is, padded to the field width */
+static void formatString(output_t *out, const char *str, size_t len, int width, int flags) {
+    int spaces = width - (int)len;
+    if (!(flags & LEFT)) {
+        pad(out, ' ', spaces);
+    }
+    emit(out, str, len);
+    if (flags & LEFT) {
+        pad(out, ' ', spaces);
+    }
+}
+
+/* The formatting engine behind vdprintf and vsnprintf */
+static int format(output_t *out, const char *fmt, va_list args) {
+    while (*fmt != 0) {
         if (*fmt != '%') {
-            *p++ = *fmt;
+            fmt = emitUntil(out, fmt, '%');
             continue;
         }
+        const char *spec = fmt;
 
-        int32_t flags = 0;
+        int flags = 0;
         while (1) {
             fmt++;
             switch (*fmt) {
@@ -99,16 +299,15 @@ int vsprintf(char *buf, const char *fmt, va_list args) {
             break;
         }
 
-        int32_t field_width = -1;
+        int field_width = -1;
         if (*fmt >= '0' && *fmt <= '9') {
-            field_width = *fmt - '0';
-            fmt++;
+            field_width = 0;
             while (*fmt >= '0' && *fmt <= '9') {
                 field_width = field_width * 10 + *fmt - '0';
                 fmt++;
             }
         } else if (*fmt == '*') {
-            field_width = va_arg(args, int32_t);
+            field_width = va_arg(args, int);
             if (field_width < 0) {
                 field_width = -field_width;
                 flags |= LEFT;
@@ -116,104 +315,234 @@ int vsprintf(char *buf, const char *fmt, va_list args) {
             fmt++;
         }
 
-        int32_t precision = -1;
+        int precision = -1;
         if (*fmt == '.') {
             fmt++;
             if (*fmt >= '0' && *fmt <= '9') {
-                precision = *fmt - '0';
-                fmt++;
+                precision = 0;
+                while (*fmt >= '0' && *fmt <= '9') {
+                    precision = precision * 10 + *fmt - '0';
+                    fmt++;
+                }
             } else if (*fmt == '*') {
-                precision = va_arg(args, int32_t);
+                precision = va_arg(args, int);
                 fmt++;
             }
             if (precision < 0)
                 precision = 0;
         }
 
-        __attribute__((unused))
-        int32_t qualifier = -1;
-        if (*fmt == 'h' || *fmt == 'l' || *fmt == 'L') {
-            qualifier = *fmt;
-            ++fmt;
+        /* Size of integer arguments: 'H' for hh, 'q' for 64 bits (ll, L, j),
+         * 'z' for size_t and ptrdiff_t (z, t) */
+        int qualifier = 0;
+        switch (*fmt) {
+            case 'h':
+                qualifier = 'h';
+                if (*++fmt == 'h') {
+                    qualifier = 'H';
+                    fmt++;
+                }
+                break;
+            case 'l':
+                qualifier = 'l';
+                if (*++fmt == 'l') {
+                    qualifier = 'q';
+                    fmt++;
+                }
+                break;
+            case 'L': case 'j':
+                qualifier = 'q';
+                fmt++;
+                break;
+            case 'z': case 't':
+                qualifier = 'z';
+                fmt++;
+                break;
         }
 
+        int radix = 0;
         switch (*fmt) {
-            case 'x': flags |= SMALL;
-            case 'X':
-                p = itoa(va_arg(args, uint32_t), p, 16, field_width, precision, flags);
-                break;
-            case 'd': case 'i': flags |= SIGN;
+            case 'd': case 'i':
+                flags |= SIGN;
             case 'u':
-                p = itoa(va_arg(args, int32_t), p, 10, field_width, precision, flags);
+                radix = 10;
                 break;
             case 'o':
-                p = itoa(va_arg(args, size_t), p, 8, field_width, precision, flags);
+                radix = 8;
                 break;
-            case 'n':;
-                int *ip = va_arg(args, int *);
-                *ip = p - tmp;
+            case 'x':
+                flags |= SMALL;
+            case 'X':
+                radix = 16;
                 break;
             case 'p':
-                p = itoa(va_arg(args, size_t), p, 16, field_width, precision, flags);
+                radix = 16;
+                qualifier = 'z';
+                break;
+            case 'n':
+                *va_arg(args, int *) = outputCount(out);
                 break;
-            case 'c':
-                if (!(flags & LEFT))
-                    while (--field_width > 0)
-                        *p++ = ' ';
-                *p++ = va_arg(args, int);
-                while (--field_width > 0)
-                    *p++ = ' ';
+            case 'c': {
+                char c = va_arg(args, int);
+                formatString(out, &c, 1, field_width, flags);
                 break;
-            case 's':;
-                char *str = va_arg(args, char *);
-                /*size_t len=strlen(str);
-                if(precision>=0&&(int)len>precision)
-                    len=precision;*/
+            }
+            case 's': {
+                const char *str = va_arg(args, const char *);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                /* A sink is given long strings as they are */
+                if (out->sink == NULL && field_width < 0 && precision < 0) {
+                    emitUntil(out, str, 0);
+                    break;
+                }
                 size_t len = precision >= 0 ? strnlen(str, precision) : strlen(str);
-                if (!(flags & LEFT))
-                    while ((int)len < field_width--)
-                        *p++ = ' ';
-                memcpy(p, str, len);
-                p += len;
-                while ((int)len < field_width--)
-                    *p++ = ' ';
+                formatString(out, str, len, field_width, flags);
                 break;
+            }
             case '%':
-                *p++ = '%';
+                emit(out, "%", 1);
                 break;
             default:
-                *p++ = '%';
+                /* Unknown conversion, print it as is */
+                emit(out, spec, fmt - spec);
                 fmt--;
                 break;
         }
+
+        if (radix) {
+            uint64_t num;
+            bool negative = false;
+            if (flags & SIGN) {
+                int64_t val;
+                switch (qualifier) {
+                    case 'H': val = (signed char)va_arg(args, int); break;
+                    case 'h': val = (short)va_arg(args, int); break;
+                    case 'l': val = va_arg(args, long); break;
+                    case 'q': val = va_arg(args, long long); break;
+                    case 'z': val = va_arg(args, ptrdiff_t); break;
+                    default: val = va_arg(args, int); break;
+                }
+                negative = val < 0;
+                num = negative ? -(uint64_t)val : (uint64_t)val;
+            } else {
+                switch (qualifier) {
+                    case 'H': num = (unsigned char)va_arg(args, unsigned int); break;
+                    case 'h': num = (unsigned short)va_arg(args, unsigned int); break;
+                    case 'l': num = va_arg(args, unsigned long); break;
+                    case 'q': num = va_arg(args, unsigned long long); break;
+                    case 'z': num = va_arg(args, size_t); break;
+                    default: num = va_arg(args, unsigned int); break;
+                }
+            }
+            formatNumber(out, num, negative, radix, field_width, precision, flags);
+        }
+        fmt++;
     }
-    *p = 0;
-    return p - buf;
+    return outputCount(out);
 }
 
-int printf(const char *fmt, ...) {
-    size_t i;
-    char buf[256];
+/**
+ * vdprintf
+ * Format into a sink. Output is gathered and passed to the sink in chunks of
+ * up to STAGE_SIZE characters, long string arguments are passed as they are.
+ * Nothing is truncated.
+ *
+ * @param sink      The sink which receives the output in chunks
+ * @param fmt       The format string
+ * @param args      Arguments of the format
+ * @return          Number of characters sent to the sink
+ */
+int vdprintf(printf_sink_t *sink, const char *fmt, va_list args) {
+    output_t out;
+    out.sink = sink;
+    out.count = 0;
+    out.base = out.pos = out.stage;
+    out.limit = out.stage + STAGE_SIZE;
+    format(&out, fmt, args);
+    flush(&out);
+    return out.count;
+}
 
+int dprintf(printf_sink_t *sink, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    i = vsprintf(buf, fmt, args);
+    int ret = vdprintf(sink, fmt, args);
     va_end(args);
-    puts(buf);
+    return ret;
+}
 
-    return i;
+static void writeConsole(printf_sink_t *sink, const char *str, size_t len) {
+    putchars(str, len);
 }
 
-int sprintf(char *dest, const char *fmt, ...) {
-    size_t i;
+static printf_sink_t console = {
+    .write = writeConsole
+};
 
+int vprintf(const char *fmt, va_list args) {
+    return vdprintf(&console, fmt, args);
+}
+
+int printf(const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    i = vsprintf(dest, fmt, args);
+    int ret = vdprintf(&console, fmt, args);
     va_end(args);
-    dest[i] = 0;
+    return ret;
+}
 
-    return i;
+/**
+ * vsnprintf
+ * Format into a buffer of the given size, the output is always terminated
+ * unless size is 0.
+ *
+ * @param buf       The buffer
+ * @param size      Size of the buffer, including the terminator
+ * @param fmt       The format string
+ * @param args      Arguments of the format
+ * @return          Length of the whole output, which may exceed size - 1
+ */
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    /* vsprintf passes SIZE_MAX, keep the end of the window from wrapping */
+    if (size > UINTPTR_MAX - (uintptr_t)buf) {
+        size = UINTPTR_MAX - (uintptr_t)buf;
+    }
+    output_t out;
+    out.sink = NULL;
+    out.count = 0;
+    out.base = out.pos = buf;
+    /* One byte is kept for the terminator */
+    out.limit = size ? buf + size - 1 : buf;
+    int ret = format(&out, fmt, args);
+    if (size) {
+        /* Once the buffer is full, the window has moved to stage */
+        if (out.base == buf) {
+            *out.pos = 0;
+        } else {
+            buf[size - 1] = 0;
+        }
+    }
+    return ret;
 }
 
+int snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+int vsprintf(char *buf, const char *fmt, va_list args) {
+    return vsnprintf(buf, SIZE_MAX, fmt, args);
+}
 
+int sprintf(char *dest, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ret = vsprintf(dest, fmt, args);
+    va_end(args);
+    return ret;
+}
@@ -0,0 +1,132 @@
+/**
+ * Provide arena allocator for data freed all together
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include "c/stdint.h"
+
+#include "mem-alloc/arena.h"
+
+#include "util/alignment.h"
+
+enum {
+    PAGE_SIZE = 4096,
+    /* Leave room for the block header, so a chunk takes whole pages */
+    CHUNK_SIZE = PAGE_SIZE * 4 - sizeof(size_t) * 2,
+    ALIGNMENT = sizeof(double)
+};
+
+typedef struct struct_chunk_t {
+    struct struct_chunk_t *prev;
+    size_t size;
+} chunk_t;
+
+struct struct_arena_t {
+    arena_source_t *source;
+    /* The chunk being bumped, the older ones are linked through prev */
+    chunk_t *chunk;
+    /* Offset of the next free byte in the current chunk */
+    size_t ptr;
+};
+
+static inline size_t getHeaderSize(void) {
+    return alignTo(sizeof(chunk_t), ALIGNMENT);
+}
+
+/**
+ * arena_create
+ * Create an arena. Memory allocated from it cannot be freed individually,
+ * but is released all together by rewinding or destroying the arena.
+ *
+ * @param source    Where to get chunks from, the arena itself is allocated
+ *                  from it too
+ * @return          The arena, or NULL if out of memory
+ */
+arena_t *arena_create(arena_source_t *source) {
+    arena_t *arena = source->alloc(source, sizeof(arena_t));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->source = source;
+    arena->chunk = NULL;
+    arena->ptr = 0;
+    return arena;
+}
+
+/**
+ * arena_alloc
+ * Allocate memory from the arena by bumping the pointer. A new chunk is
+ * started when the current one cannot hold the request.
+ *
+ * @param arena     The arena to allocate from
+ * @param size      Size of memory wanted
+ * @return          The memory aligned for any type, or NULL if out of memory
+ */
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = alignTo(size, ALIGNMENT);
+    chunk_t *chunk = arena->chunk;
+    if (chunk == NULL || chunk->size - arena->ptr < size) {
+        size_t chunkSize = getHeaderSize() + size;
+        if (chunkSize < CHUNK_SIZE) {
+            chunkSize = CHUNK_SIZE;
+        }
+        chunk = arena->source->alloc(arena->source, chunkSize);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->prev = arena->chunk;
+        chunk->size = chunkSize;
+        arena->chunk = chunk;
+        arena->ptr = getHeaderSize();
+    }
+    void *ret = (void *)((size_t)chunk + arena->ptr);
+    arena->ptr += size;
+    return ret;
+}
+
+/**
+ * arena_mark
+ * Record the current position of the arena.
+ *
+ * @param arena     The arena
+ * @return          The position, to be passed to arena_rewind
+ */
+arena_mark_t arena_mark(arena_t *arena) {
+    arena_mark_t mark = {
+        .chunk = arena->chunk,
+        .ptr = arena->ptr
+    };
+    return mark;
+}
+
+/**
+ * arena_rewind
+ * Release everything allocated after the mark was taken.
+ *
+ * @param arena     The arena
+ * @param mark      The position returned by arena_mark
+ */
+void arena_rewind(arena_t *arena, arena_mark_t mark) {
+    while (arena->chunk != mark.chunk) {
+        chunk_t *chunk = arena->chunk;
+        arena->chunk = chunk->prev;
+        arena->source->free(arena->source, chunk);
+    }
+    arena->ptr = mark.ptr;
+}
+
+/**
+ * arena_destroy
+ * Release the arena and all memory allocated from it.
+ *
+ * @param arena     The arena
+ */
+void arena_destroy(arena_t *arena) {
+    arena_mark_t empty = {
+        .chunk = NULL,
+        .ptr = 0
+    };
+    arena_rewind(arena, empty);
+    arena->source->free(arena->source, arena);
+}
@@ -20,13 +20,32 @@
 enum {
     PAGE_SIZE = 4096,
     BLOCK_SIZE = sizeof(size_t) * 2,
-    MAX_SIZE = PAGE_SIZE - BLOCK_SIZE * 2,
-    ARR_LEN = MAX_SIZE / BLOCK_SIZE
+    /* A fresh page holds the block, a spare block and the end protector */
+    MAX_SIZE = PAGE_SIZE - BLOCK_SIZE * 4,
+    /* A free block can take up to the whole page except the protector */
+    ARR_LEN = (PAGE_SIZE - BLOCK_SIZE * 2) / BLOCK_SIZE,
+    MAP_LEN = (ARR_LEN + 31) / 32,
+    /* Blocks up to MID_SIZE may be carved from spans of 2^SPAN_LEVEL pages */
+    MID_SIZE = PAGE_SIZE * 16,
+    SPAN_LEVEL = 6,
+    /* Four classes for each power of two from PAGE_SIZE up to the span size */
+    MID_CLASSES = SPAN_LEVEL * 4
 };
 
 struct struct_allocator_t {
     pageman_t *man;
+    /* Bit n is set if any list in map[n] is not empty */
+    uint32_t summary;
+    /* Bit n of map[i] is set if blocks[i * 32 + n] is not empty */
+    uint32_t map[MAP_LEN];
     list_t blocks[ARR_LEN];
+    /* Bit n is set if mid[n] is not empty */
+    uint32_t midMap;
+    /* Free blocks too big for blocks[], sorted into classes by size */
+    list_t mid[MID_CLASSES];
+#ifndef NSTATS
+    allocator_stats_t stats;
+#endif
 };
 
 typedef struct struct_block_t {
@@ -45,6 +64,10 @@ static size_t getPagePow(size_t size) {
     }
 }
 
+static inline size_t getPageNum(size_t size) {
+    return alignTo(size, PAGE_SIZE) / PAGE_SIZE;
+}
+
 static inline block_t *nextBlock(block_t *this) {
     return (block_t *)((size_t)&this->list + (this->size & ~3));
 }
@@ -53,13 +76,92 @@ static inline block_t *prevBlock(block_t *this) {
     return this->prev;
 }
 
+/* Find the first non-empty list whose index is no less than id, -1 if none */
+static inline int findList(allocator_t *al, int id) {
+    int word = id / 32;
+    uint32_t bits = al->map[word] & (~(uint32_t)0 << (id % 32));
+    if (bits) {
+        return word * 32 + lowestBit(bits);
+    }
+    uint32_t words = al->summary & (~(uint32_t)1 << word);
+    if (words == 0) {
+        return -1;
+    }
+    word = lowestBit(words);
+    return word * 32 + lowestBit(al->map[word]);
+}
+
+/* Blocks which waste no more than an eighth when rounded up to pages are
+ * given whole pages, others above MAX_SIZE are carved from spans */
+static inline bool isLarge(size_t size) {
+    if (size > MID_SIZE) {
+        return true;
+    }
+    size_t bytes = getPageNum(offsetof(block_t, list) + size) * PAGE_SIZE;
+    return size > MAX_SIZE && bytes - size <= bytes / 8;
+}
+
+/* Class 0 also takes the few sizes just below PAGE_SIZE */
+static inline int getMidClass(size_t size) {
+    if (size < PAGE_SIZE) {
+        return 0;
+    }
+    size_t order = log2(size);
+    return (order - 12) * 4 + ((size >> (order - 2)) & 3);
+}
+
+/* The smallest free block which goes into the class */
+static inline size_t getMidClassMin(int id) {
+    if (id == 0) {
+        return (ARR_LEN + 1) * BLOCK_SIZE;
+    }
+    size_t order = id / 4 + 12;
+    return (size_t)(4 + id % 4) << (order - 2);
+}
+
+/* Find a mid-size free block of at least size bytes, NULL if none. The
+ * request is rounded up to the next class unless it is the smallest size
+ * of its own, so the first block of any class found is big enough. */
+static block_t *findMid(allocator_t *al, size_t size) {
+    int id = getMidClass(size);
+    if (size > getMidClassMin(id)) {
+        id++;
+    }
+    uint32_t classes = al->midMap & (~(uint32_t)0 << id);
+    if (classes == 0) {
+        return NULL;
+    }
+    return GET_DATA(al->mid[lowestBit(classes)].next, block_t, list);
+}
+
 static inline void markFree(allocator_t *al, block_t *b) {
-    list_addFirst(&al->blocks[b->size / BLOCK_SIZE - 1], &b->list);
+    int id = b->size / BLOCK_SIZE - 1;
+    if (id < ARR_LEN) {
+        list_addFirst(&al->blocks[id], &b->list);
+        al->map[id / 32] |= (uint32_t)1 << (id % 32);
+        al->summary |= (uint32_t)1 << (id / 32);
+    } else {
+        id = getMidClass(b->size & ~3);
+        list_addFirst(&al->mid[id], &b->list);
+        al->midMap |= (uint32_t)1 << id;
+    }
     b->size &= ~1;
 }
 
-static inline void markUsed(block_t *b) {
+static inline void markUsed(allocator_t *al, block_t *b) {
+    int id = b->size / BLOCK_SIZE - 1;
     list_remove(&b->list);
+    if (id >= ARR_LEN) {
+        id = getMidClass(b->size & ~3);
+        if (list_isEmpty(&al->mid[id])) {
+            al->midMap &= ~((uint32_t)1 << id);
+        }
+    } else if (list_isEmpty(&al->blocks[id])) {
+        al->map[id / 32] &= ~((uint32_t)1 << (id % 32));
+        if (al->map[id / 32] == 0) {
+            al->summary &= ~((uint32_t)1 << (id / 32));
+        }
+    }
     b->size |= 1;
 }
 
@@ -86,64 +188,118 @@ static void mergeBlock(block_t *first) {
     assert(nextBlock(first) == third);
 }
 
+#ifndef NSTATS
+/* Bucket 0 holds sizes up to 8, bucket n holds sizes in (2^(n+2), 2^(n+3)] */
+static inline size_t getBucket(size_t size) {
+    return size <= 8 ? 0 : log2(size - 1) - 2;
+}
+
+static inline void statAlloc(allocator_t *al, block_t *block) {
+    size_t size = block->size & ~7;
+    size_t bucket = getBucket(size);
+    al->stats.allocs[bucket]++;
+    al->stats.bytes[bucket] += size;
+    al->stats.used += size;
+    if (al->stats.used > al->stats.peak) {
+        al->stats.peak = al->stats.used;
+    }
+}
+
+static inline void statFree(allocator_t *al, block_t *block) {
+    size_t size = block->size & ~7;
+    al->stats.frees[getBucket(size)]++;
+    al->stats.used -= size;
+}
+
+#define statCount(al, field) ((al)->stats.field++)
+#else
+static inline void statAlloc(allocator_t *al, block_t *block) {}
+static inline void statFree(allocator_t *al, block_t *block) {}
+
+#define statCount(al, field) ((void)0)
+#endif
+
 allocator_t *allocator_create(pageman_t *man) {
     allocator_t *allocator = pageman_alloc(man, getPagePow(sizeof(allocator_t)));
     assert(allocator);
     allocator->man = man;
+    allocator->summary = 0;
+    for (int i = 0; i < MAP_LEN; i++) {
+        allocator->map[i] = 0;
+    }
     for (int i = 0; i < ARR_LEN; i++) {
         list_empty(&allocator->blocks[i]);
     }
+    allocator->midMap = 0;
+    for (int i = 0; i < MID_CLASSES; i++) {
+        list_empty(&allocator->mid[i]);
+    }
+#ifndef NSTATS
+    memset(&allocator->stats, 0, sizeof(allocator_stats_t));
+#endif
     return allocator;
 }
 
-void allocator_free(allocator_t *al, void *addr) {
-    /* According to c spec, we do nothing if null */
-    if (addr == NULL) {
-        return;
-    }
-
-    block_t *block = GET_DATA(addr, block_t, list);
-
-    if (block->size & 4) {
-        block = block->prev;
-    }
-
-    /* If it is a big block and is directly allocated by pageman */
-    if (block->size & 2) {
-        pageman_free(al->man, block, getPagePow(sizeof(block_t) + block->size));
-        return;
-    }
-
+/* Return a small block, merging it with free blocks around it */
+static void freeBlock(allocator_t *al, block_t *block) {
     block_t *prev = prevBlock(block);
     block_t *next = nextBlock(block);
 
     /* We are the first block, and the next block is the protector:
-     * we merged successfully into one page. */
+     * we merged successfully into one page or span. */
     if (prev == NULL && next->size == 1) {
-        pageman_free(al->man, block, 0);
+        pageman_free(al->man, block, getPagePow((block->size & ~3) + offsetof(block_t, list) * 2));
         return;
     }
     /* If we can merge to previous block */
     if (prev != NULL && isFree(prev)) {
-        markUsed(prev);
+        markUsed(al, prev);
         mergeBlock(prev);
-        allocator_free(al, &prev->list);
+        freeBlock(al, prev);
         return;
     }
     /* If we can merge to next block */
     if (isFree(next)) {
-        markUsed(next);
+        markUsed(al, next);
         mergeBlock(block);
-        allocator_free(al, &block->list);
+        freeBlock(al, block);
         return;
     }
     markFree(al, block);
 }
 
+void allocator_free(allocator_t *al, void *addr) {
+    /* According to c spec, we do nothing if null */
+    if (addr == NULL) {
+        return;
+    }
+
+    block_t *block = GET_DATA(addr, block_t, list);
+
+    if (block->size & 4) {
+        block = block->prev;
+    }
+    statFree(al, block);
+
+    /* If it is a big block and is directly allocated by pageman */
+    if (block->size & 2) {
+        pageman_freePages(al->man, block, getPageNum(offsetof(block_t, list) + (block->size & ~3)));
+        return;
+    }
+    freeBlock(al, block);
+}
+
 void *allocator_malloc(allocator_t *al, size_t size) {
-    if (size > MAX_SIZE) {
-        block_t *block = pageman_alloc(al->man, getPagePow(sizeof(block_t) + size));
+    if (isLarge(size)) {
+        /* Keep the flag bits clear of the size */
+        size = alignTo(size, BLOCK_SIZE);
+        block_t *block = pageman_allocPages(al->man, getPageNum(offsetof(block_t, list) + size));
+        if (block == NULL) {
+            return NULL;
+        }
         block->size = size | 3;
+        statCount(al, large);
+        statAlloc(al, block);
         return &block->list;
     }
 
@@ -153,40 +309,32 @@ void *allocator_malloc(allocator_t *al, size_t size) {
         size = alignTo(size, BLOCK_SIZE);
     }
 
-    int id = size / BLOCK_SIZE - 1;
-    list_t *list = &al->blocks[id];
-    /* If there is a block of the same size */
-    if (!list_isEmpty(list)) {
-        /* We appreciate that and return */
-        block_t *block = GET_DATA(list->next, block_t, list);
-        markUsed(block);
-        return &block->list;
-    }
-
-
-    list = &al->blocks[++id];
-    /* Next block size. If we seperate this block,
-     * we will get a block of size 0, so, it is better
-     * to give a free upgrade to the requester */
-    if (!list_isEmpty(list)) {
-        block_t *block = GET_DATA(list->next, block_t, list);
-        markUsed(block);
-        return &block->list;
+    block_t *block;
+    if (size > MAX_SIZE) {
+        block = findMid(al, size);
+    } else {
+        int found = findList(al, size / BLOCK_SIZE - 1);
+        block = found == -1 ? NULL : GET_DATA(al->blocks[found].next, block_t, list);
     }
-
-    for (id++; id < ARR_LEN; id++) {
-        list_t *list = &al->blocks[id];
-        if (!list_isEmpty(list)) {
-            block_t *block = GET_DATA(list->next, block_t, list);
-            markUsed(block);
+    if (block) {
+        markUsed(al, block);
+        /* If there is a block of the same size, we appreciate that and return.
+         * For next block size, if we seperate this block, we will get a
+         * block of size 0, so, it is better to give a free upgrade to the requester */
+        if ((block->size & ~3) >= size + BLOCK_SIZE * 2) {
             splitBlock(block, size);
             markFree(al, nextBlock(block));
-            return &block->list;
+            statCount(al, split);
+        } else {
+            statCount(al, exact);
         }
+        statAlloc(al, block);
+        return &block->list;
     }
 
-    /* If we run of out memory */
-    void *page = pageman_alloc(al->man, 0);
+    /* If we run of out memory, small blocks get a new page and mid-size blocks a new span */
+    size_t spanSize = size > MAX_SIZE ? PAGE_SIZE << SPAN_LEVEL : PAGE_SIZE;
+    void *page = pageman_alloc(al->man, size > MAX_SIZE ? SPAN_LEVEL : 0);
     if (page == NULL) {
         return NULL;
     }
@@ -197,17 +345,32 @@ void *allocator_malloc(allocator_t *al, size_t size) {
 
     block_t *rest = nextBlock(firstBlock);
     rest->prev = firstBlock;
-    rest->size = (size_t)page + PAGE_SIZE - (size_t)&rest->list - offsetof(block_t, list);
+    rest->size = (size_t)page + spanSize - (size_t)&rest->list - offsetof(block_t, list);
 
     block_t *endProtect = nextBlock(rest);
     endProtect->prev = rest;
     endProtect->size = 1;
 
     markFree(al, rest);
+    statCount(al, fresh);
+    statAlloc(al, firstBlock);
     return &firstBlock->list;
 }
 
 void *allocator_calloc(allocator_t *al, size_t nmemb, size_t size) {
+    size_t total = nmemb * size;
+    if (isLarge(total)) {
+        /* Big blocks come from pages which may be known to be clean */
+        total = alignTo(total, BLOCK_SIZE);
+        block_t *block = pageman_allocPagesZeroed(al->man, getPageNum(offsetof(block_t, list) + total));
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = total | 3;
+        statCount(al, large);
+        statAlloc(al, block);
+        return &block->list;
+    }
     void *mem = allocator_malloc(al, nmemb * size);
     if (mem == NULL) {
         return NULL;
@@ -216,8 +379,73 @@ void *allocator_calloc(allocator_t *al, size_t nmemb, size_t size) {
     return mem;
 }
 
+/* Shrink a used block to the given size, the rest is freed if it is big enough */
+static void shrinkBlock(allocator_t *al, block_t *block, size_t size) {
+    if ((block->size & ~3) >= size + BLOCK_SIZE * 2) {
+        splitBlock(block, size);
+        freeBlock(al, nextBlock(block));
+    }
+}
+
 void *allocator_realloc(allocator_t *al, void *addr, size_t size) {
-    size_t original = GET_DATA(addr, block_t, list)->size;
+    if (addr == NULL) {
+        return allocator_malloc(al, size);
+    }
+
+    block_t *block = GET_DATA(addr, block_t, list);
+    size_t original;
+
+    if (block->size & 4) {
+        /* Aligned blocks are never resized in place */
+        block_t *real = block->prev;
+        original = (size_t)&real->list + (real->size & ~3) - (size_t)addr;
+    } else if (block->size & 2) {
+        /* Big blocks shrink by returning pages, and grow by taking the pages after them */
+        original = block->size & ~3;
+        size_t aligned = alignTo(size, BLOCK_SIZE);
+        size_t pages = getPageNum(offsetof(block_t, list) + original);
+        size_t newPages = getPageNum(offsetof(block_t, list) + aligned);
+        if (newPages <= pages) {
+            if (newPages < pages) {
+                pageman_freePages(al->man, (void *)((size_t)block + newPages * PAGE_SIZE), pages - newPages);
+            }
+            statFree(al, block);
+            block->size = aligned | 3;
+            statAlloc(al, block);
+            statCount(al, inPlace);
+            return addr;
+        }
+        if (pageman_extendPages(al->man, block, pages, newPages)) {
+            statFree(al, block);
+            block->size = aligned | 3;
+            statAlloc(al, block);
+            statCount(al, inPlace);
+            return addr;
+        }
+    } else {
+        original = block->size & ~3;
+        size_t aligned = size < BLOCK_SIZE ? BLOCK_SIZE : alignTo(size, BLOCK_SIZE);
+        if (aligned <= original) {
+            statFree(al, block);
+            shrinkBlock(al, block, aligned);
+            statAlloc(al, block);
+            statCount(al, inPlace);
+            return addr;
+        }
+        /* Merge with the next block if it is free and we fit in together */
+        block_t *next = nextBlock(block);
+        if (isFree(next) && original + offsetof(block_t, list) + next->size >= aligned) {
+            statFree(al, block);
+            markUsed(al, next);
+            mergeBlock(block);
+            shrinkBlock(al, block, aligned);
+            statAlloc(al, block);
+            statCount(al, inPlace);
+            return addr;
+        }
+    }
+
+    /* Copying is the last resort */
     void *ret = allocator_malloc(al, size);
     if (ret == NULL) {
         return NULL;
@@ -227,6 +455,27 @@ void *allocator_realloc(allocator_t *al, void *addr, size_t size) {
     return ret;
 }
 
+/**
+ * allocator_usableSize
+ * Get the number of bytes usable in an allocated memory, which can be
+ * larger than the size requested.
+ *
+ * @param al        The allocator
+ * @param addr      The memory returned by the allocator
+ * @return          The usable size of the memory
+ */
+size_t allocator_usableSize(allocator_t *al, void *addr) {
+    if (addr == NULL) {
+        return 0;
+    }
+    block_t *block = GET_DATA(addr, block_t, list);
+    if (block->size & 4) {
+        block_t *real = block->prev;
+        return (size_t)&real->list + (real->size & ~3) - (size_t)addr;
+    }
+    return block->size & ~3;
+}
+
 void *allocator_aligned_alloc(allocator_t *al, size_t alignment, size_t size) {
     if ((1 << log2(alignment)) != alignment) {
         return NULL;
@@ -235,9 +484,12 @@ void *allocator_aligned_alloc(allocator_t *al, size_t alignment, size_t size) {
         return allocator_malloc(al, size);
     }
 
-    size_t aligned_size = size + alignment - sizeof(size_t) * 2;
-    void *ret = allocator_malloc(al, aligned_size);
-    void *alignedRet = (void *)alignTo((size_t)ret, alignment);
+    /* Leave at least one header in front, so the marker never overwrites the real header */
+    void *ret = allocator_malloc(al, size + alignment);
+    if (ret == NULL) {
+        return NULL;
+    }
+    void *alignedRet = (void *)alignTo((size_t)ret + 1, alignment);
 
     block_t *block = GET_DATA(alignedRet, block_t, list);
     block->size = 4;
@@ -245,3 +497,19 @@ void *allocator_aligned_alloc(allocator_t *al, size_t alignment, size_t size) {
 
     return alignedRet;
 }
+
+/**
+ * allocator_getStats
+ * Copy out the statistics of an allocator. Everything is zero if the
+ * allocator is compiled with NSTATS.
+ *
+ * @param al        The allocator
+ * @param stats     The structure to fill in
+ */
+void allocator_getStats(allocator_t *al, allocator_stats_t *stats) {
+#ifndef NSTATS
+    memcpy(stats, &al->stats, sizeof(allocator_stats_t));
+#else
+    memset(stats, 0, sizeof(allocator_stats_t));
+#endif
+}
@@ -0,0 +1,206 @@
+/**
+ * Provide object cache for fixed-size objects
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#include "c/stdint.h"
+#include "c/stdbool.h"
+#include "c/assert.h"
+
+#include "mem-alloc/pageman.h"
+#include "mem-alloc/objcache.h"
+
+#include "data-struct/list.h"
+
+#include "util/alignment.h"
+#include "util/log2.h"
+
+enum {
+    PAGE_SIZE = 4096
+};
+
+/* Each slab is a single page, so the slab of an object is found by
+ * aligning the object down. Slab header is at the start of the page. */
+typedef struct struct_slab_t {
+    list_t list;
+    objcache_t *cache;
+    void *free;
+    size_t inuse;
+} slab_t;
+
+struct struct_objcache_t {
+    pageman_t *man;
+    const char *name;
+    size_t size;
+    size_t offset;
+    size_t perSlab;
+    void (*ctor)(void *);
+    list_t partial;
+    list_t full;
+    /* An empty slab kept to avoid allocating and freeing a page repeatedly */
+    slab_t *spare;
+    /* Pages held by the slabs, the spare included */
+    size_t pages;
+};
+
+/* Caches themselves are allocated from this cache */
+static objcache_t cacheCache;
+
+static void initCache(objcache_t *cache, pageman_t *man, const char *name, size_t size, size_t align, void (*ctor)(void *)) {
+    if (size < sizeof(void *)) {
+        size = sizeof(void *);
+    }
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    cache->man = man;
+    cache->name = name;
+    cache->size = alignTo(size, align);
+    cache->offset = alignTo(sizeof(slab_t), align);
+    cache->perSlab = (PAGE_SIZE - cache->offset) / cache->size;
+    cache->ctor = ctor;
+    cache->spare = NULL;
+    cache->pages = 0;
+    list_empty(&cache->partial);
+    list_empty(&cache->full);
+}
+
+/**
+ * objcache_create
+ * Create a cache of objects of the same size.
+ *
+ * @param man       The page manager to get slabs from
+ * @param name      Name of the cache, for debugging purpose
+ * @param size      Size of each object
+ * @param align     Alignment of each object, must be a power of 2 which
+ *                  leaves room for the slab header in the page
+ * @param ctor      Function called on each object before handed out, can be NULL
+ * @return          The cache, or NULL if the alignment is invalid, the object
+ *                  is too big or out of memory
+ */
+objcache_t *objcache_create(pageman_t *man, const char *name, size_t size, size_t align, void (*ctor)(void *)) {
+    /* Larger alignments would put the first object past the page */
+    if (align == 0 || align > PAGE_SIZE - sizeof(slab_t) || (1 << log2(align)) != align) {
+        return NULL;
+    }
+    /* Keep alignTo from wrapping around, such objects never fit anyway */
+    if (size > PAGE_SIZE) {
+        return NULL;
+    }
+    if (cacheCache.man == NULL) {
+        initCache(&cacheCache, man, "objcache", sizeof(objcache_t), sizeof(void *), NULL);
+    }
+    objcache_t *cache = objcache_alloc(&cacheCache);
+    if (cache == NULL) {
+        return NULL;
+    }
+    initCache(cache, man, name, size, align, ctor);
+    if (cache->perSlab == 0) {
+        objcache_free(&cacheCache, cache);
+        return NULL;
+    }
+    return cache;
+}
+
+static slab_t *newSlab(objcache_t *cache) {
+    slab_t *slab = cache->spare;
+    if (slab) {
+        cache->spare = NULL;
+        return slab;
+    }
+    slab = pageman_alloc(cache->man, 0);
+    if (slab == NULL) {
+        return NULL;
+    }
+    cache->pages++;
+    slab->cache = cache;
+    slab->inuse = 0;
+    /* Chain all objects together, lowest address first */
+    void **link = &slab->free;
+    for (size_t i = 0; i < cache->perSlab; i++) {
+        void *obj = (void *)((size_t)slab + cache->offset + i * cache->size);
+        *link = obj;
+        link = obj;
+    }
+    *link = NULL;
+    return slab;
+}
+
+/**
+ * objcache_alloc
+ * Allocate an object from the cache.
+ *
+ * @param cache     The cache to allocate from
+ * @return          The object, or NULL if out of memory
+ */
+void *objcache_alloc(objcache_t *cache) {
+    slab_t *slab;
+    if (list_isEmpty(&cache->partial)) {
+        slab = newSlab(cache);
+        if (slab == NULL) {
+            return NULL;
+        }
+        list_addFirst(&cache->partial, &slab->list);
+    } else {
+        slab = GET_DATA(cache->partial.next, slab_t, list);
+    }
+
+    void *obj = slab->free;
+    slab->free = *(void **)obj;
+    slab->inuse++;
+    if (slab->free == NULL) {
+        list_remove(&slab->list);
+        list_addFirst(&cache->full, &slab->list);
+    }
+
+    if (cache->ctor) {
+        cache->ctor(obj);
+    }
+    return obj;
+}
+
+/**
+ * objcache_free
+ * Return an object to the cache it was allocated from.
+ *
+ * @param cache     The cache which the object belongs to
+ * @param obj       The object
+ */
+void objcache_free(objcache_t *cache, void *obj) {
+    if (obj == NULL) {
+        return;
+    }
+    slab_t *slab = (slab_t *)alignDown((size_t)obj, PAGE_SIZE);
+    assert(slab->cache == cache);
+
+    /* A full slab becomes partial again */
+    if (slab->free == NULL) {
+        list_remove(&slab->list);
+        list_addFirst(&cache->partial, &slab->list);
+    }
+    *(void **)obj = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+
+    if (slab->inuse == 0) {
+        list_remove(&slab->list);
+        if (cache->spare == NULL) {
+            cache->spare = slab;
+        } else {
+            pageman_free(cache->man, slab, 0);
+            cache->pages--;
+        }
+    }
+}
+
+/**
+ * objcache_getPages
+ * Count the pages the cache holds, whether its objects are in use or not.
+ *
+ * @param cache     The cache
+ * @return          Number of pages
+ */
+size_t objcache_getPages(objcache_t *cache) {
+    return cache->pages;
+}
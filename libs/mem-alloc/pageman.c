@@ -11,18 +11,32 @@
 #include "c/assert.h"
 #include "mem-alloc/pageman.h"
 #include "util/alignment.h"
+#include "util/log2.h"
 
 enum {
     PAGE_SIZE = 4096,
-    TOTAL_LEVEL = 18,
+    TOTAL_LEVEL = PAGEMAN_TOTAL_LEVEL,
 };
 
 struct struct_pageman_t {
     bitmap_t *bitmaps[TOTAL_LEVEL];
     list_t lists[TOTAL_LEVEL];
+    /* Bit n is set if and only if lists[n] is not empty */
+    size_t avail;
     void *base;
     size_t limit;
     size_t spare;
+    /* Spare size right after creation */
+    size_t total;
+    /* Next zone in the zone list */
+    pageman_t *next;
+#ifndef NSTATS
+    /* Counters are only kept in the first zone */
+    size_t used;
+    size_t peak;
+    size_t allocs[TOTAL_LEVEL];
+    size_t frees[TOTAL_LEVEL];
+#endif
 };
 
 static inline size_t getOffset(void *base, void *addr, size_t level) {
@@ -31,6 +45,18 @@ static inline size_t getOffset(void *base, void *addr, size_t level) {
     return off >> (level + 1);
 }
 
+/* Every free block starts with this header. The bytes right after the
+ * header which are known to be zero are counted in zero, so a block
+ * is entirely clean when zero reaches getClean(level). */
+typedef struct {
+    list_t list;
+    size_t zero;
+} free_t;
+
+static inline size_t getClean(size_t level) {
+    return (PAGE_SIZE << level) - sizeof(free_t);
+}
+
 static inline void *getBuddy(void *base, void *addr, size_t level) {
     size_t off = (size_t)addr - (size_t)base;
     return (void *)((off ^ ((size_t)PAGE_SIZE << level)) + (size_t)base);
@@ -41,6 +67,100 @@ static inline void *getSuper(void *base, void *addr, size_t level) {
     return (void *)((off & ~((size_t)PAGE_SIZE << level)) + (size_t)base);
 }
 
+/* The bitmaps are never cleared as a whole. The bit of a pair is only
+ * meaningful while its parent block is split, so it is written when the
+ * parent gets split, and the bits inside a block are cleared when the
+ * block is handed out. Bits inside free blocks may contain garbage. */
+
+/* Flip the buddy bit of the block. Return true if its buddy is free.
+ * Blocks on the top level have no buddy, so they never combine. */
+static inline bool switchBuddy(pageman_t *bpm, void *addr, size_t level) {
+    if (level == TOTAL_LEVEL - 1) {
+        return false;
+    }
+    return bitmap_switch(bpm->bitmaps[level], getOffset(bpm->base, addr, level));
+}
+
+/* Clean blocks are kept at the tail, so plain allocations take dirty
+ * blocks first and the zeroing pass only needs to look at the head. */
+static inline void addFree(pageman_t *bpm, void *addr, size_t level, size_t zero) {
+    free_t *block = addr;
+    block->zero = zero;
+    if (zero == getClean(level)) {
+        list_addLast(bpm->lists + level, &block->list);
+    } else {
+        list_addFirst(bpm->lists + level, &block->list);
+    }
+    bpm->avail |= (size_t)1 << level;
+}
+
+static inline void removeFree(pageman_t *bpm, void *addr, size_t level) {
+    list_remove((list_t *)addr);
+    if (list_isEmpty(bpm->lists + level)) {
+        bpm->avail &= ~((size_t)1 << level);
+    }
+}
+
+/* Mark every pair inside the block as busy */
+static void clearInner(pageman_t *bpm, void *addr, size_t level) {
+    for (size_t i = 0; i < level; i++) {
+        bitmap_clearRange(bpm->bitmaps[i], getOffset(bpm->base, addr, i), (size_t)1 << (level - i - 1));
+    }
+}
+
+/* Put a block whose buddy is known to be busy into the pool */
+static void insertBlock(pageman_t *bpm, void *addr, size_t level, size_t zero) {
+    if (level != TOTAL_LEVEL - 1) {
+        bitmap_set(bpm->bitmaps[level], getOffset(bpm->base, addr, level));
+    }
+    bpm->spare += PAGE_SIZE << level;
+    addFree(bpm, addr, level, zero);
+}
+
+/* Same as insertBlock, for memory whose content is unknown */
+static void insertDirty(pageman_t *bpm, void *addr, size_t level) {
+    insertBlock(bpm, addr, level, 0);
+}
+
+/* Slice a range into aligned pieces and pass each one to the callback */
+static void sliceRange(pageman_t *bpm, void *addr, size_t size, void (*fn)(pageman_t *, void *, size_t)) {
+    /* Maually align, note during the align process, some memory will never be allocated */
+    size_t off = alignTo((size_t)addr, PAGE_SIZE) - (size_t)bpm->base;
+    size = alignDown((size_t)addr - (size_t)bpm->base + size, PAGE_SIZE);
+    if (size <= off) {
+        return;
+    }
+    size -= off;
+
+    /* These three following loops just slice the memory into aligned pieces.
+     * Blocks never exceed the top level, so larger ranges are cut into top level blocks. */
+    size_t i, single_size;
+    for (i = 0; i < TOTAL_LEVEL - 1; i++) {
+        single_size = (size_t)PAGE_SIZE << i;
+        if ((off & single_size) && (size >= single_size)) {
+            fn(bpm, (void *)((size_t)bpm->base + off), i);
+            off += single_size;
+            size -= single_size;
+        }
+    }
+
+    single_size = (size_t)PAGE_SIZE << (TOTAL_LEVEL - 1);
+    while (size >= single_size) {
+        fn(bpm, (void *)((size_t)bpm->base + off), TOTAL_LEVEL - 1);
+        off += single_size;
+        size -= single_size;
+    }
+
+    for (i = TOTAL_LEVEL - 2; i != (size_t) - 1; i--) {
+        single_size = (size_t)PAGE_SIZE << i;
+        if (size >= single_size) {
+            fn(bpm, (void *)((size_t)bpm->base + off), i);
+            off += single_size;
+            size -= single_size;
+        }
+    }
+}
+
 /**
  * pageman_create
  * Create an instance of page manager using buddy algorithm.
@@ -59,35 +179,162 @@ pageman_t *pageman_create(void *base, size_t limit, void *firstAval, size_t firs
     /* We need to fill in this array first before fill in the real one */
     bitmap_t *bitmaps[TOTAL_LEVEL];
     for (level = 0; level < TOTAL_LEVEL; level++) {
-        /* The first byte in the bitmap is the next byte after all previous bitmaps */
-        bitmaps[level] = (unsigned char *)firstAval + totalSize + sizeof(pageman_t);
+        /* The first word in the bitmap is the next word after all previous bitmaps */
+        bitmaps[level] = (bitmap_t *)((char *)firstAval + alignTo(sizeof(pageman_t), sizeof(bitmap_t)) + totalSize);
         /* Get the number of bit occupied by a certain level
          * The size of the bitmap is the index of the last bit plus one.
          * And don't forget that we will count the size in bytes instead of bits
          */
-        levelSize = alignTo(getOffset(base, lastPage, level) + 1, 8) / 8;
+        levelSize = bitmap_getSize(getOffset(base, lastPage, level) + 1);
         totalSize += levelSize;
     }
     /* Calculate the size of pageman_t structure */
-    size_t pageCost = alignTo(totalSize + sizeof(pageman_t), PAGE_SIZE) / PAGE_SIZE;
+    size_t pageCost = alignTo(totalSize + alignTo(sizeof(pageman_t), sizeof(bitmap_t)), PAGE_SIZE) / PAGE_SIZE;
     /* We need this argument basicly to check if condtion is satisfied */
-    assert(pageCost <= firstSize);
+    if (pageCost > firstSize) {
+        return NULL;
+    }
     /* Initialize the sturcture */
     pageman_t *man = firstAval;
     man->base = base;
     man->limit = limit;
     man->spare = 0;
+    man->avail = 0;
+    man->next = NULL;
+#ifndef NSTATS
+    man->used = 0;
+    man->peak = 0;
+    memset(man->allocs, 0, sizeof(man->allocs));
+    memset(man->frees, 0, sizeof(man->frees));
+#endif
+    /* The bitmaps are left uninitialized, see the comment above switchBuddy */
     memcpy(man->bitmaps, bitmaps, sizeof(bitmaps));
-    memset((unsigned char *)firstAval + sizeof(pageman_t), 0, totalSize);//TODO NEED?NEED.
     for (level = 0; level < TOTAL_LEVEL; level++)
         list_empty(man->lists + level);
     /* Since only the manager knows how much memory it used, we need
-     * to free the first block inside this function */
-    pageman_freeBlock(man, (void *)((size_t)firstAval + (size_t)PAGE_SIZE * pageCost), (firstSize - pageCost)*PAGE_SIZE);
+     * to free the first block inside this function. The pieces are
+     * maximal, so they go straight into the pool without merging. */
+    sliceRange(man, (void *)((size_t)firstAval + (size_t)PAGE_SIZE * pageCost), (firstSize - pageCost)*PAGE_SIZE, insertDirty);
+    man->total = man->spare;
 
     return man;
 }
 
+/**
+ * pageman_addZone
+ * Append a zone to the zone list of a page manager. The zone is another
+ * page manager instance, usually created on a separate memory region.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param zone      The zone to be added
+ */
+void pageman_addZone(pageman_t *bpm, pageman_t *zone) {
+    while (bpm->next) {
+        bpm = bpm->next;
+    }
+    bpm->next = zone;
+}
+
+/* Find the zone which the address belongs to */
+static pageman_t *findZone(pageman_t *bpm, void *addr) {
+    for (; bpm; bpm = bpm->next) {
+        /* Compare in pages, so a zone ending at 4GiB does not overflow */
+        if (((size_t)addr - (size_t)bpm->base) / PAGE_SIZE < bpm->limit) {
+            return bpm;
+        }
+    }
+    assert(0);
+    return NULL;
+}
+
+static void zoneFree(pageman_t *bpm, void *addr, size_t size) {
+    /* Content of the returned memory is unknown */
+    size_t zero = 0;
+    /* If the previous value was true, a combination will take place. */
+    while (switchBuddy(bpm, addr, size)) {
+        bpm->spare -= PAGE_SIZE << size;
+        /* If its buddy is free, we remove the buddy page from the bool. */
+        free_t *buddy = getBuddy(bpm->base, addr, size);
+        removeFree(bpm, buddy, size);
+        /* The clean part of the combined block continues into the upper
+         * half only if the lower half is entirely clean */
+        size_t lower = buddy < (free_t *)addr ? buddy->zero : zero;
+        free_t *upper = buddy < (free_t *)addr ? addr : buddy;
+        size_t upperZero = buddy < (free_t *)addr ? zero : buddy->zero;
+        if (lower != getClean(size)) {
+            zero = lower;
+        } else if (upperZero) {
+            memset(upper, 0, sizeof(free_t));
+            zero = (PAGE_SIZE << size) + upperZero;
+        } else {
+            zero = lower;
+        }
+        /* Then we continue with the combined one */
+        addr = getSuper(bpm->base, addr, size);
+        size++;
+    }
+    bpm->spare += PAGE_SIZE << size;
+    /* If its buddy is busy, we just return the page into the pool */
+    addFree(bpm, addr, size, zero);
+}
+
+/* Allocate a block, and tell how many bytes after its header are clean.
+ * If clean is true, the block is taken from the tail of the list. */
+static void *zoneAlloc(pageman_t *bpm, size_t size, bool clean, size_t *zero) {
+    /* Find the smallest non-empty level which is big enough */
+    size_t candidate = bpm->avail & ~(((size_t)1 << size) - 1);
+    /* Assurance to prevent out of memory */
+    if (candidate == 0) {
+        return NULL;
+    }
+    size_t level = lowestBit(candidate);
+    /* Get the first one out from the linked list */
+    free_t *first = GET_DATA(clean ? bpm->lists[level].prev : bpm->lists[level].next, free_t, list);
+    size_t known = first->zero;
+    removeFree(bpm, first, level);
+    switchBuddy(bpm, first, level);
+    bpm->spare -= PAGE_SIZE << level;
+    /* Slice it ^_^, the upper halves go back to the pool */
+    while (level > size) {
+        level--;
+        size_t half = PAGE_SIZE << level;
+        insertBlock(bpm, getBuddy(bpm->base, first, level), level, known > half ? known - half : 0);
+        if (known > getClean(level)) {
+            known = getClean(level);
+        }
+    }
+    clearInner(bpm, first, size);
+    *zero = known;
+    return first;
+}
+
+/* Clear the first bytes of a block whose first zero bytes after the header are clean */
+static void fillZero(void *addr, size_t zero, size_t bytes) {
+    size_t clean = sizeof(free_t) + zero;
+    memset(addr, 0, sizeof(free_t));
+    if (clean < bytes) {
+        memset((char *)addr + clean, 0, bytes - clean);
+    }
+}
+
+#ifndef NSTATS
+static inline void statAlloc(pageman_t *bpm, size_t level, size_t count, size_t bytes) {
+    bpm->allocs[level] += count;
+    bpm->used += bytes;
+    if (bpm->used > bpm->peak) {
+        bpm->peak = bpm->used;
+    }
+}
+
+static inline void statFree(pageman_t *bpm, size_t level, size_t count, size_t bytes) {
+    bpm->frees[level] += count;
+    bpm->used -= bytes;
+}
+#else
+static inline void statAlloc(pageman_t *bpm, size_t level, size_t count, size_t bytes) {}
+static inline void statFree(pageman_t *bpm, size_t level, size_t count, size_t bytes) {}
+#endif
+
 /**
  * pageman_free
  * Return a piece of memory back to the manager.
@@ -97,24 +344,14 @@ pageman_t *pageman_create(void *base, size_t limit, void *firstAval, size_t firs
  * @param size      Size of the block, meaning that PAGE_SIZE<<size is spare.
  */
 void pageman_free(pageman_t *bpm, void *addr, size_t size) {
-    size_t offset = getOffset(bpm->base, addr, size);
-    /* If the previous value was true, a combination will take place. */
-    if (size < TOTAL_LEVEL && bitmap_switch(bpm->bitmaps[size], offset)) {
-        bpm->spare -= PAGE_SIZE << size;
-        /* If its buddy is free, we remove the buddy page from the bool. */
-        list_remove((list_t *)getBuddy(bpm->base, addr, size));
-        /* Then we free the combined one */
-        pageman_free(bpm, getSuper(bpm->base, addr, size), size + 1);
-    } else {
-        bpm->spare += PAGE_SIZE << size;
-        /* If its buddy is busy, we just return the page into the pool */
-        list_addFirst(bpm->lists + size, (list_t *)addr);
-    }
+    statFree(bpm, size, 1, PAGE_SIZE << size);
+    zoneFree(findZone(bpm, addr), addr, size);
 }
 
 /**
  * pageman_alloc
- * Allocate a piece of memory from the manager.
+ * Allocate a piece of memory from the manager. Zones are tried in the
+ * order they were added, so the first zone is preferred.
  *
  * @param bpm       The pointer to manager instance
  * @param size      Size of the block, meaning that PAGE_SIZE<<size should be allocated.
@@ -125,76 +362,367 @@ void *pageman_alloc(pageman_t *bpm, size_t size) {
     if (size >= TOTAL_LEVEL) {
         return NULL;
     }
-    if (list_isEmpty(bpm->lists + size)) {
-        /* Get a super one */
-        void *addr = pageman_alloc(bpm, size + 1);
-        /* Assurance to prevent out of memory */
-        if (addr == NULL) {
-            return NULL;
+    for (pageman_t *zone = bpm; zone; zone = zone->next) {
+        size_t zero;
+        void *ret = zoneAlloc(zone, size, false, &zero);
+        if (ret) {
+            statAlloc(bpm, size, 1, PAGE_SIZE << size);
+            return ret;
         }
-        /* Slice it ^_^ */
-        pageman_free(bpm, getBuddy(bpm->base, addr, size), size);
-        return addr;
-    } else {
-        bpm->spare -= PAGE_SIZE << size;
-        /* Get the first one out from the linked list */
+    }
+    return NULL;
+}
+
+/**
+ * pageman_allocZeroed
+ * Allocate a piece of zero-filled memory from the manager. Blocks known
+ * to be clean are preferred, and only the unknown part is cleared.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param size      Size of the block, meaning that PAGE_SIZE<<size should be allocated.
+ * @return          The start of the block
+ */
+void *pageman_allocZeroed(pageman_t *bpm, size_t size) {
+    if (size >= TOTAL_LEVEL) {
+        return NULL;
+    }
+    for (pageman_t *zone = bpm; zone; zone = zone->next) {
+        size_t zero;
+        void *ret = zoneAlloc(zone, size, true, &zero);
+        if (ret) {
+            statAlloc(bpm, size, 1, PAGE_SIZE << size);
+            fillZero(ret, zero, PAGE_SIZE << size);
+            return ret;
+        }
+    }
+    return NULL;
+}
+
+static size_t zoneAllocBatch(pageman_t *bpm, size_t size, size_t count, void **out) {
+    size_t got = 0;
+    /* Blocks of the exact size are taken first */
+    while (got < count && !list_isEmpty(bpm->lists + size)) {
         list_t *first = bpm->lists[size].next;
-        /* Remove the block from the spare list */
-        list_remove(first);
-        /* Set the bit in the bitmap */
-        bitmap_switch(bpm->bitmaps[size], getOffset(bpm->base, first, size));
-        return first;
+        removeFree(bpm, first, size);
+        switchBuddy(bpm, first, size);
+        bpm->spare -= PAGE_SIZE << size;
+        clearInner(bpm, first, size);
+        out[got++] = first;
     }
+    /* Then bigger blocks are carved up as a whole instead of being split level by level */
+    while (got < count) {
+        size_t candidate = bpm->avail & ~(((size_t)2 << size) - 1);
+        if (candidate == 0) {
+            break;
+        }
+        size_t level = lowestBit(candidate);
+        list_t *first = bpm->lists[level].next;
+        removeFree(bpm, first, level);
+        switchBuddy(bpm, first, level);
+        bpm->spare -= PAGE_SIZE << level;
+        clearInner(bpm, first, level);
+
+        size_t total = (size_t)1 << (level - size);
+        size_t used = count - got < total ? count - got : total;
+        for (size_t i = 0; i < used; i++) {
+            out[got++] = (void *)((size_t)first + (i * PAGE_SIZE << size));
+        }
+        /* The buddies of the leftover pieces are all in the used part */
+        if (used != total) {
+            sliceRange(bpm, (void *)((size_t)first + (used * PAGE_SIZE << size)),
+                       (total - used) * PAGE_SIZE << size, insertDirty);
+        }
+    }
+    return got;
 }
 
 /**
- * pageman_freeBlock
- * Return a piece of memory back to the manager.
+ * pageman_allocBatch
+ * Allocate a number of blocks of the same size in one pass.
  *
  * @param bpm       The pointer to manager instance
- * @param addr      The start of the block
- * @param size      Size of the block measured in bytes
+ * @param size      Size of each block, meaning that PAGE_SIZE<<size should be allocated.
+ * @param count     Number of blocks wanted
+ * @param out       Array receiving the start of the blocks
+ * @return          Number of blocks actually allocated
  */
-void pageman_freeBlock(pageman_t *bpm, void *addr, size_t size) {
-    /* Maually align, note during the align process, some memory will never be allocated */
-    size_t off = alignTo((size_t)addr, PAGE_SIZE) - (size_t)bpm->base;
-    size = alignDown(size, PAGE_SIZE);
+size_t pageman_allocBatch(pageman_t *bpm, size_t size, size_t count, void **out) {
+    if (size >= TOTAL_LEVEL) {
+        return 0;
+    }
+    size_t got = 0;
+    for (pageman_t *zone = bpm; zone && got < count; zone = zone->next) {
+        got += zoneAllocBatch(zone, size, count - got, out + got);
+    }
+    statAlloc(bpm, size, got, got * (PAGE_SIZE << size));
+    return got;
+}
 
-    /* These two following loops just slice the memory into aligned pieces and free them */
-    size_t i, single_size;
-    for (i = 0; i <= TOTAL_LEVEL; i++) {
-        single_size = (size_t)PAGE_SIZE << i;
-        if ((off & single_size) && (size >= single_size)) {
-            pageman_free(bpm, (void *)((size_t)bpm->base + off), i);
-            off += single_size;
-            size -= single_size;
+/**
+ * pageman_freeBatch
+ * Return a number of blocks of the same size. The array is sorted by
+ * address, so that buddies next to each other combine before reaching
+ * the free lists.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param size      Size of each block, meaning that PAGE_SIZE<<size is spare.
+ * @param count     Number of blocks
+ * @param blocks    Array of the start of the blocks, will be reordered
+ */
+void pageman_freeBatch(pageman_t *bpm, size_t size, size_t count, void **blocks) {
+    statFree(bpm, size, count, count * (PAGE_SIZE << size));
+    /* Batches are small, so insertion sort will do */
+    for (size_t i = 1; i < count; i++) {
+        void *cur = blocks[i];
+        size_t j = i;
+        for (; j > 0 && (size_t)blocks[j - 1] > (size_t)cur; j--) {
+            blocks[j] = blocks[j - 1];
         }
+        blocks[j] = cur;
     }
+    for (size_t i = 0; i < count; i++) {
+        pageman_t *zone = findZone(bpm, blocks[i]);
+        /* Both halves are freed, so the combined block can go back directly */
+        if (size != TOTAL_LEVEL - 1 && i + 1 < count &&
+                blocks[i + 1] == getBuddy(zone->base, blocks[i], size) &&
+                (size_t)blocks[i] < (size_t)blocks[i + 1]) {
+            zoneFree(zone, blocks[i], size + 1);
+            i++;
+        } else {
+            zoneFree(zone, blocks[i], size);
+        }
+    }
+}
 
-    single_size = (size_t)PAGE_SIZE << TOTAL_LEVEL;
-    while (size >= single_size) {
-        pageman_free(bpm, (void *)((size_t)bpm->base + off), i);
-        off += single_size;
-        size -= single_size;
+static void *allocRun(pageman_t *bpm, size_t pages, bool clean) {
+    if (pages == 0) {
+        return NULL;
+    }
+    size_t level = log2(pages);
+    if (((size_t)1 << level) != pages) {
+        level++;
+    }
+    if (level >= TOTAL_LEVEL) {
+        return NULL;
+    }
+    void *addr = NULL;
+    size_t zero;
+    for (pageman_t *zone = bpm; zone && !addr; zone = zone->next) {
+        addr = zoneAlloc(zone, level, clean, &zero);
+    }
+    if (addr == NULL) {
+        return NULL;
     }
+    statAlloc(bpm, level, 1, PAGE_SIZE << level);
+    /* Only the run itself needs to be cleared */
+    if (clean) {
+        fillZero(addr, zero, pages * PAGE_SIZE);
+    }
+    size_t rest = ((size_t)1 << level) - pages;
+    if (rest) {
+        pageman_freeBlock(bpm, (void *)((size_t)addr + pages * PAGE_SIZE), rest * PAGE_SIZE);
+    }
+    return addr;
+}
 
-    for (i = TOTAL_LEVEL - 1; i != (size_t) - 1; i--) {
-        single_size = (size_t)PAGE_SIZE << i;
-        if (size >= single_size) {
-            pageman_free(bpm, (void *)((size_t)bpm->base + off), i);
-            off += single_size;
-            size -= single_size;
+/**
+ * pageman_allocPages
+ * Allocate a run of contiguous pages. The smallest block covering the
+ * run is allocated, and the pages after the run go back immediately.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param pages     Number of pages to allocate
+ * @return          The start of the run
+ */
+void *pageman_allocPages(pageman_t *bpm, size_t pages) {
+    return allocRun(bpm, pages, false);
+}
+
+/**
+ * pageman_allocPagesZeroed
+ * Allocate a run of contiguous zero-filled pages.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param pages     Number of pages to allocate
+ * @return          The start of the run
+ */
+void *pageman_allocPagesZeroed(pageman_t *bpm, size_t pages) {
+    return allocRun(bpm, pages, true);
+}
+
+/**
+ * pageman_freePages
+ * Return a run of pages allocated by pageman_allocPages.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param addr      The start of the run
+ * @param pages     Number of pages in the run
+ */
+void pageman_freePages(pageman_t *bpm, void *addr, size_t pages) {
+#ifndef NSTATS
+    size_t level = log2(pages);
+    if (((size_t)1 << level) != pages) {
+        level++;
+    }
+    bpm->frees[level]++;
+#endif
+    pageman_freeBlock(bpm, addr, pages * PAGE_SIZE);
+}
+
+/**
+ * pageman_extendPages
+ * Try to grow a run of pages in place, by taking the free blocks right
+ * after the run. Nothing is changed if any of them is not free.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param addr      The start of the run
+ * @param pages     Number of pages currently in the run
+ * @param newPages  Number of pages wanted
+ * @return          true if the run now has newPages pages
+ */
+bool pageman_extendPages(pageman_t *bpm, void *addr, size_t pages, size_t newPages) {
+    if (pages == 0) {
+        return false;
+    }
+    pageman_t *head = bpm;
+    bpm = findZone(bpm, addr);
+    size_t start = ((size_t)addr - (size_t)bpm->base) / PAGE_SIZE + pages;
+    size_t end = start - pages + newPages;
+    size_t off, level;
+
+    /* The block starting at off is the upper half of its pair, and its buddy
+     * holds the page before it, which is in use. So its bit tells whether the
+     * block itself is free. Check them all before taking anything. */
+    for (off = start; off < end; off += (size_t)1 << level) {
+        level = lowestBit(off);
+        if (level >= TOTAL_LEVEL - 1 || off + ((size_t)1 << level) > bpm->limit ||
+                !bitmap_get(bpm->bitmaps[level], off >> (level + 1))) {
+            return false;
         }
     }
+
+    for (off = start; off < end; off += (size_t)1 << level) {
+        level = lowestBit(off);
+        void *block = (void *)((size_t)bpm->base + off * PAGE_SIZE);
+        removeFree(bpm, block, level);
+        switchBuddy(bpm, block, level);
+        bpm->spare -= PAGE_SIZE << level;
+        clearInner(bpm, block, level);
+    }
+    /* Give back what is taken beyond the end */
+    if (off != end) {
+        sliceRange(bpm, (void *)((size_t)bpm->base + end * PAGE_SIZE), (off - end) * PAGE_SIZE, zoneFree);
+    }
+    statAlloc(head, 0, 0, (newPages - pages) * PAGE_SIZE);
+    return true;
+}
+
+/**
+ * pageman_freeBlock
+ * Return a piece of memory back to the manager. The memory must have
+ * been allocated from the manager, but it can be any part of a block.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param addr      The start of the block
+ * @param size      Size of the block measured in bytes
+ */
+void pageman_freeBlock(pageman_t *bpm, void *addr, size_t size) {
+    statFree(bpm, 0, 0, size);
+    bpm = findZone(bpm, addr);
+
+    sliceRange(bpm, addr, size, zoneFree);
 }
 
 /**
  * pageman_spare
- * Query spare size in a given pageman_t instance.
+ * Query spare size in a given pageman_t instance, summed over all zones.
  *
  * @param bpm       The pointer to manager instance
  * @return          The memory available in page manager measured in bytes
  */
 size_t pageman_spare(pageman_t *bpm) {
-    return bpm->spare;
+    size_t spare = 0;
+    for (; bpm; bpm = bpm->next) {
+        spare += bpm->spare;
+    }
+    return spare;
+}
+
+/**
+ * pageman_zeroIdle
+ * Clear some free memory in advance, so later zero-filled allocations
+ * find it already clean. Meant to be called when there is nothing else
+ * to do. Big blocks are cleared first, and a block may be cleared over
+ * several calls.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param budget    Maximum number of bytes to clear
+ * @return          Number of bytes cleared
+ */
+size_t pageman_zeroIdle(pageman_t *bpm, size_t budget) {
+    size_t done = 0;
+    for (; bpm; bpm = bpm->next) {
+        for (size_t level = TOTAL_LEVEL; level-- > 0;) {
+            list_t *list = bpm->lists + level;
+            /* Dirty blocks are at the head, so stop at the first clean one */
+            while (done < budget && list->next != list) {
+                free_t *block = GET_DATA(list->next, free_t, list);
+                size_t left = getClean(level) - block->zero;
+                if (left == 0) {
+                    break;
+                }
+                if (left > budget - done) {
+                    left = budget - done;
+                }
+                memset((char *)(block + 1) + block->zero, 0, left);
+                block->zero += left;
+                done += left;
+                if (block->zero == getClean(level)) {
+                    list_remove(&block->list);
+                    list_addLast(list, &block->list);
+                }
+            }
+            if (done == budget) {
+                return done;
+            }
+        }
+    }
+    return done;
+}
+
+/**
+ * pageman_getStats
+ * Collect the statistics of a page manager. The free block counts and
+ * the fragmentation are computed from the free lists on each call, the
+ * rest are zero if the manager is compiled with NSTATS.
+ *
+ * @param bpm       The pointer to manager instance
+ * @param stats     The structure to fill in
+ */
+void pageman_getStats(pageman_t *bpm, pageman_stats_t *stats) {
+    memset(stats, 0, sizeof(pageman_stats_t));
+#ifndef NSTATS
+    stats->used = bpm->used;
+    stats->peak = bpm->peak;
+    memcpy(stats->allocs, bpm->allocs, sizeof(stats->allocs));
+    memcpy(stats->frees, bpm->frees, sizeof(stats->frees));
+#endif
+    for (; bpm; bpm = bpm->next) {
+        stats->spare += bpm->spare;
+        stats->total += bpm->total;
+        for (size_t level = 0; level < TOTAL_LEVEL; level++) {
+            for (list_t *node = bpm->lists[level].next; node != &bpm->lists[level]; node = node->next) {
+                stats->freeBlocks[level]++;
+                stats->zero += GET_DATA(node, free_t, list)->zero;
+            }
+        }
+    }
+    /* Fragmentation of a level is the share of free memory that is in
+     * blocks too small to satisfy a request of that level */
+    size_t small = 0, spare = stats->spare / PAGE_SIZE;
+    for (size_t level = 0; level < TOTAL_LEVEL; level++) {
+        /* Counted in pages, so the product does not overflow */
+        stats->unusable[level] = spare ? small * 100 / spare : 0;
+        small += stats->freeBlocks[level] << level;
+    }
 }
@@ -1,4 +1,5 @@
 #include "c/stdint.h"
+#include "c/stdbool.h"
 #include "c/stdio.h"
 #include "c/string.h"
 
@@ -57,7 +58,7 @@ int putchar(int character) {
             break;
         }
         default: {
-            *(uint16_t *)(VIDEO_ADDRESS + calcOffset(x, y)) = character | (0xF << 8);
+            *(uint16_t *)(VIDEO_ADDRESS + calcOffset(x, y)) = (unsigned char)character | (0xF << 8);
             x++;
             if (x == CHAR_PER_LINE) {
                 x = 0;
@@ -72,3 +73,39 @@ int putchar(int character) {
     }
     return character;
 }
+
+/* Characters which move the cursor instead of being displayed */
+static inline bool isControl(char c) {
+    return c == '\r' || c == '\n' || c == '\t' || c == '\f';
+}
+
+void putchars(const char *str, size_t len) {
+    /* Work on a copy of the cursor, stored back once at the end */
+    size_t cx = x, cy = y;
+    size_t i = 0;
+    while (i < len) {
+        if (isControl(str[i])) {
+            x = cx;
+            y = cy;
+            putchar(str[i++]);
+            cx = x;
+            cy = y;
+            continue;
+        }
+        /* Plain characters up to the end of the line need no scroll check */
+        uint16_t *cell = (uint16_t *)(VIDEO_ADDRESS + calcOffset(cx, cy));
+        for (; i < len && cx < CHAR_PER_LINE && !isControl(str[i]); i++, cx++) {
+            *cell++ = (unsigned char)str[i] | (0xF << 8);
+        }
+        if (cx == CHAR_PER_LINE) {
+            cx = 0;
+            cy++;
+            if (cy == LINE_PER_SCREEN) {
+                lineWrap();
+                cy--;
+            }
+        }
+    }
+    x = cx;
+    y = cy;
+}
@@ -19,12 +19,7 @@ int unicode_utf16Cmp(void *x, void *y) {
 }
 
 int unicode_utf16Hash(void *key) {
-    utf16_string_t *c = key;
-    int32_t h = 0;
-    for (int i = 0; i < c->len; i++) {
-        h = 31 * h + c->str[i];
-    }
-    return h;
+    return unicode_utf16KeyHash(*(utf16_string_t *)key);
 }
 
 hashmap_t *hashmap_new_utf16(int size) {